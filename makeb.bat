@@ -1 +1 @@
-gcc -Wall -o main -g src\simulation.c src\main.c src\renderer.c src\shader.c src\camera.c src\model_parser.c src\polygon.c src\debug.c src\timer.c src\input.c src\physics.c src\priority_queue.c -I lib\GLFW\include -I lib\GLEW\include -I lib\cglm\include -I lib\CIMGUI -L lib\GLEW\lib\Release\x64 -L lib\GLFW\lib-mingw-w64 -lglew32s -l glfw3 -lgdi32 -lopengl32 -DCGLM_FORCE_LEFT_HANDED
\ No newline at end of file
+gcc -Wall -o main -g src\simulation.c src\main.c src\renderer.c src\shader.c src\camera.c src\model_parser.c src\polygon.c src\debug.c src\timer.c src\input.c src\physics.c src\priority_queue.c src\parallel.c src\cull.c src\surface.c src\image.c src\capture.c src\mesh.c src\benchmark.c src\triple_buffer.c src\job.c src\arena.c -I lib\GLFW\include -I lib\GLEW\include -I lib\cglm\include -I lib\CIMGUI -L lib\GLEW\lib\Release\x64 -L lib\GLFW\lib-mingw-w64 -lglew32s -l glfw3 -lgdi32 -lopengl32 -pthread -DCGLM_FORCE_LEFT_HANDED %*
\ No newline at end of file
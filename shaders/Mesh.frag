@@ -0,0 +1,16 @@
+#version 330 core
+
+layout(location = 0) out vec4 fragColor;
+in vec3 vWorldPosition;
+
+uniform vec3 color;
+uniform vec3 lightDirection; // Unit vector towards the light
+
+void main()
+{
+    // .obj files loaded by the model parser have no normals, so each face is shaded
+    // with the normal of its plane; either side may face the camera
+    vec3 normal = normalize(cross(dFdx(vWorldPosition), dFdy(vWorldPosition)));
+    float diffuse = abs(dot(normal, lightDirection));
+    fragColor = vec4(color * (0.3 + 0.7 * diffuse), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(location = 0) in vec3 position;
+
+uniform vec3 origin;
+uniform float scale;
+
+layout (std140) uniform Matrices
+{
+    mat4 vpMatrix;
+};
+
+out vec3 vWorldPosition;
+
+void main()
+{
+    vWorldPosition = position * scale + origin;
+    gl_Position = vpMatrix * vec4(vWorldPosition, 1.0);
+}
\ No newline at end of file
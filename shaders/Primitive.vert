@@ -0,0 +1,90 @@
+#version 430 core
+
+// Per instance: primitive type in the top 8 bits, index within its array in the rest
+layout(location = 1) in uint tag;
+
+const uint TypeCircle = 0;
+const uint TypeRect = 1;
+const uint TypeLine2D = 2;
+const uint TypeLine = 3;
+const uint TypePoint = 4;
+
+// Declares the position attribute (location 0) and the primitive structs, generated from
+// their C layouts in polygon.h and polygon.c
+#include "Primitives.glsl"
+
+// Each block is bound to its type's range of the PrimitiveStorage buffer in polygon.c
+layout (std430) readonly buffer Circles
+{
+    Circle circles[];
+};
+
+layout (std430) readonly buffer Rects
+{
+    Rect rects[];
+};
+
+layout (std430) readonly buffer Line2Ds
+{
+    Line2D line2Ds[];
+};
+
+layout (std430) readonly buffer Lines
+{
+    Line lines[];
+};
+
+layout (std430) readonly buffer Points
+{
+    Point points[];
+};
+
+layout (std140) uniform Matrices
+{
+    mat4 vpMatrix;
+};
+
+out vec3 vColor;
+
+void main()
+{
+    uint type = tag >> 24;
+    uint index = tag & 0xFFFFFFu;
+
+    vec3 pos;
+    gl_PointSize = 1.0;
+
+    if (type == TypeCircle)
+    {
+        Circle c = circles[index];
+        pos = vec3(position * c.radius + c.position, 0.0);
+        vColor = c.color.rgb;
+    }
+    else if (type == TypeRect)
+    {
+        Rect r = rects[index];
+        pos = vec3(vec2(position.x * r.width, position.y * r.height) + r.position, 0.0);
+        vColor = r.color.rgb;
+    }
+    else if (type == TypeLine2D)
+    {
+        Line2D l = line2Ds[index];
+        pos = vec3(mix(l.a, l.b, position.x), 0.0);
+        vColor = l.color.rgb;
+    }
+    else if (type == TypeLine)
+    {
+        Line l = lines[index];
+        pos = mix(l.a, l.b, position.x);
+        vColor = l.color.rgb;
+    }
+    else
+    {
+        Point p = points[index];
+        pos = p.position;
+        gl_PointSize = p.pointSize;
+        vColor = p.color;
+    }
+
+    gl_Position = vpMatrix * vec4(pos, 1.0);
+}
\ No newline at end of file
@@ -1,11 +1,28 @@
 #version 330 core
 
+// Analytic surfaces replace the next line with #define SURFACE_FUNCTION
+// and their float SurfaceHeight(float x, float y, float t)
+// #SurfaceFunction
+
+#ifdef SURFACE_FUNCTION
+uniform vec2 domainMin;
+uniform float domainStep;
+uniform float time;
+#else
 layout(location = 0) in float height;
-layout(location = 1) in vec3 color;
+#endif
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec4 normal;
 
 uniform vec3 origin;
 uniform float scale;
 uniform int n;
+uniform int rowOffset; // The first row shown of a streaming surface's ring of rows
+uniform int colorMode; // SurfaceColorMode: grid position, vertex colors or colormap
+uniform sampler1D colormap;
+uniform vec2 colormapRange; // The heights at the ends of the colormap
+uniform bool lit;
+uniform vec3 lightDirection; // Unit vector towards the light
 
 layout (std140) uniform Matrices
 {
@@ -16,12 +33,48 @@ out vec3 vColor;
 
 void main()
 {
-    float x = mod(float(gl_VertexID), float(n));
-    float y = floor(float(gl_VertexID) / float(n));
+    // gl_VertexID includes the tile's base vertex
+    // Integer math keeps grids with more than 2^24 vertices exact
+    float x = float(gl_VertexID % n);
+    float y = float((gl_VertexID / n - rowOffset + n) % n);
+
+#ifdef SURFACE_FUNCTION
+    vec2 samplePoint = domainMin + vec2(x, y) * domainStep;
+    float height = SurfaceHeight(samplePoint.x, samplePoint.y, time);
+#endif
 
     vec2 coord = vec2(x, y) * scale;
     vec3 pos = vec3(coord.x, height, coord.y) + origin; // Assume y is up
 
     gl_Position = vpMatrix * vec4(pos, 1.0);
-    vColor = vec3(x / n, y / n, 1.0);
+
+    if (colorMode == 1)
+    {
+        vColor = color.rgb;
+    }
+    else if (colorMode == 2)
+    {
+        float t = (height - colormapRange.x) / (colormapRange.y - colormapRange.x);
+        vColor = texture(colormap, t).rgb;
+    }
+    else
+    {
+        vColor = vec3(x / n, y / n, 1.0);
+    }
+
+    if (lit)
+    {
+#ifdef SURFACE_FUNCTION
+        // Central differences of the function one grid step apart
+        float slopeX = SurfaceHeight(samplePoint.x - domainStep, samplePoint.y, time) -
+            SurfaceHeight(samplePoint.x + domainStep, samplePoint.y, time);
+        float slopeY = SurfaceHeight(samplePoint.x, samplePoint.y - domainStep, time) -
+            SurfaceHeight(samplePoint.x, samplePoint.y + domainStep, time);
+        vec3 surfaceNormal = vec3(slopeX * 0.5 / scale, 1.0, slopeY * 0.5 / scale);
+#else
+        vec3 surfaceNormal = normal.xyz;
+#endif
+        float diffuse = max(dot(normalize(surfaceNormal), lightDirection), 0.0);
+        vColor *= 0.3 + 0.7 * diffuse;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+import os
+import shutil
+import subprocess
+import sys
+
+# Renders a few scenes headless and compares the last frame of each to smoke_reference.txt
+# Frames are reduced to the average color of a grid of blocks, so the small differences between
+# rasterizers pass while missing or misplaced geometry does not
+# Usage: python smoke.py [--update] [program]; --update writes the reference from this build
+# Lines of the reference starting with # say how it was made; one starting with "# unverified"
+# marks a reference that the shipped program has not produced
+
+program = os.path.join(".", "main")
+frameCount = 30
+gridWidth = 32
+gridHeight = 18
+tolerance = 12 # the most a block's average channel may differ, out of 255
+frameDirectory = "smoke_frames"
+referencePath = "smoke_reference.txt"
+
+# The default scene's surface is analytic, evaluated in the vertex shader
+scenes = {
+    "default": [],
+    "cpu": ["--circles", "2000", "--surface", "129", "--cull", "cpu"],
+    "gpu": ["--circles", "2000", "--surface", "129", "--cull", "gpu"],
+    "mesh": ["--mesh", "elephant.obj"],
+}
+
+
+# Returns the average color of each block, row by row, as a flat list of channels
+def ReadBlockColors(filePath):
+    with open(filePath, "rb") as file:
+        data = file.read()
+
+    headerEnd = data.index(b"\n") + 1
+    magic, width, height, maxValue = data[:headerEnd].split()
+    width = int(width)
+    height = int(height)
+
+    sums = [0] * (gridWidth * gridHeight * 3)
+    for y in range(height):
+        row = data[headerEnd + y * width * 3 : headerEnd + (y + 1) * width * 3]
+        blockY = y * gridHeight // height
+        for blockX in range(gridWidth):
+            start = blockX * width // gridWidth * 3
+            end = (blockX + 1) * width // gridWidth * 3
+            block = (blockY * gridWidth + blockX) * 3
+            for channel in range(3):
+                sums[block + channel] += sum(row[start + channel : end : 3])
+
+    colors = []
+    for blockY in range(gridHeight):
+        blockHeight = (blockY + 1) * height // gridHeight - blockY * height // gridHeight
+        for blockX in range(gridWidth):
+            blockWidth = (blockX + 1) * width // gridWidth - blockX * width // gridWidth
+            block = (blockY * gridWidth + blockX) * 3
+            for channel in range(3):
+                colors.append(round(sums[block + channel] / (blockWidth * blockHeight)))
+
+    return colors
+
+
+# Renders the scene and returns the block colors of its last frame and the program's output,
+# or None if it failed
+def RenderScene(name, arguments):
+    pattern = os.path.join(frameDirectory, name + "_%05lu.ppm")
+    command = [program, "--headless", "--frames", str(frameCount), "--capture", pattern] + arguments
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    if result.returncode != 0:
+        print(f"'{name}' exited with {result.returncode}:\n")
+        print(result.stdout.decode("utf-8", "replace"))
+        return None, None
+
+    frames = sorted(file for file in os.listdir(frameDirectory) if file.startswith(name + "_"))
+    if not frames:
+        print(f"'{name}' wrote no frames")
+        return None, None
+
+    return ReadBlockColors(os.path.join(frameDirectory, frames[-1])), result.stdout.decode("utf-8", "replace")
+
+
+update = "--update" in sys.argv[1:]
+arguments = [argument for argument in sys.argv[1:] if argument != "--update"]
+if arguments:
+    program = arguments[0]
+
+reference = {}
+if not update:
+    with open(referencePath) as file:
+        for line in file:
+            if line.startswith("#"):
+                print(line.rstrip())
+                if line.startswith("# unverified"):
+                    print("Warning: matching this reference does not show that the program renders correctly")
+                continue
+
+            values = line.split()
+            reference[values[0]] = [int(value) for value in values[1:]]
+
+os.makedirs(frameDirectory, exist_ok=True)
+results = {}
+versions = set()
+failed = False
+
+for name, sceneArguments in scenes.items():
+    colors, output = RenderScene(name, sceneArguments)
+    if colors is None:
+        failed = True
+        continue
+
+    versions.update(line.strip() for line in output.splitlines() if line.startswith("OpenGL version:"))
+
+    results[name] = colors
+    if update:
+        print(f"Rendered '{name}'")
+        continue
+
+    differences = [abs(a - b) for a, b in zip(colors, reference[name])]
+    blocks = sum(1 for i in range(0, len(differences), 3) if max(differences[i : i + 3]) > tolerance)
+    if blocks > 0:
+        print(f"'{name}' differs from the reference in {blocks} blocks (at most {max(differences)})")
+        failed = True
+    else:
+        print(f"'{name}' matches the reference (at most {max(differences)})")
+
+shutil.rmtree(frameDirectory)
+
+if update and not failed:
+    with open(referencePath, "w") as file:
+        file.write(f"# program {program}\n")
+        for version in sorted(versions):
+            file.write(f"# {version}\n")
+        for name, colors in results.items():
+            file.write(name + " " + " ".join(str(value) for value in colors) + "\n")
+    print(f"Wrote '{referencePath}'")
+
+sys.exit(1 if failed else 0)
\ No newline at end of file
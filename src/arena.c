@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "arena.h"
+
+#define ScratchBlockSize (64 * 1024)
+#define FrameBlockSize (256 * 1024)
+
+// Allocations start at the first aligned offset after the block header
+#define BlockHeaderSize ((sizeof(ArenaBlock) + ArenaAlignment - 1) / ArenaAlignment * ArenaAlignment)
+
+static _Thread_local Arena* scratchArena;
+static pthread_key_t scratchArenaKey;
+static pthread_once_t scratchArenaKeyOnce = PTHREAD_ONCE_INIT;
+
+static Arena frameArena = { NULL, FrameBlockSize, 0 };
+
+void ArenaInitialize(Arena* arena, size_t blockSize)
+{
+    arena->block = NULL;
+    arena->blockSize = blockSize;
+    arena->totalCapacity = 0;
+}
+
+static void AddBlock(Arena* arena, size_t capacity)
+{
+    ArenaBlock* block = malloc(BlockHeaderSize + capacity);
+    block->previous = arena->block;
+    block->capacity = capacity;
+    block->used = 0;
+
+    arena->block = block;
+    arena->totalCapacity += capacity;
+}
+
+void* ArenaAlloc(Arena* arena, size_t size)
+{
+    size = (size + ArenaAlignment - 1) / ArenaAlignment * ArenaAlignment;
+
+    ArenaBlock* block = arena->block;
+    if (block == NULL || block->used + size > block->capacity)
+    {
+        AddBlock(arena, size > arena->blockSize ? size : arena->blockSize);
+        block = arena->block;
+    }
+
+    void* memory = (char*)block + BlockHeaderSize + block->used;
+    block->used += size;
+    return memory;
+}
+
+ArenaMark ArenaSave(Arena* arena)
+{
+    ArenaMark mark = { arena->block, arena->block ? arena->block->used : 0 };
+    return mark;
+}
+
+void ArenaRestore(Arena* arena, ArenaMark mark)
+{
+    while (arena->block && arena->block != mark.block && arena->block->previous)
+    {
+        ArenaBlock* block = arena->block;
+        arena->block = block->previous;
+        arena->totalCapacity -= block->capacity;
+        free(block);
+    }
+
+    // A mark saved before the first block was added restores to the empty first block
+    if (arena->block) arena->block->used = arena->block == mark.block ? mark.used : 0;
+}
+
+void ArenaReset(Arena* arena)
+{
+    if (arena->block && arena->block->previous)
+    {
+        size_t capacity = arena->totalCapacity;
+        ArenaDelete(arena);
+        AddBlock(arena, capacity);
+    }
+
+    if (arena->block) arena->block->used = 0;
+}
+
+void ArenaDelete(Arena* arena)
+{
+    while (arena->block)
+    {
+        ArenaBlock* block = arena->block;
+        arena->block = block->previous;
+        free(block);
+    }
+
+    arena->totalCapacity = 0;
+}
+
+// Frees a thread's scratch arena when it exits
+static void DeleteScratchArena(void* arena)
+{
+    ArenaDelete(arena);
+    free(arena);
+}
+
+static void CreateScratchArenaKey()
+{
+    pthread_key_create(&scratchArenaKey, DeleteScratchArena);
+}
+
+Arena* ArenaScratch()
+{
+    if (scratchArena) return scratchArena;
+
+    pthread_once(&scratchArenaKeyOnce, CreateScratchArenaKey);
+    scratchArena = malloc(sizeof(Arena));
+    ArenaInitialize(scratchArena, ScratchBlockSize);
+    pthread_setspecific(scratchArenaKey, scratchArena);
+    return scratchArena;
+}
+
+void* ArenaFrameAlloc(size_t size)
+{
+    return ArenaAlloc(&frameArena, size);
+}
+
+void ArenaFrameReset()
+{
+    ArenaReset(&frameArena);
+}
\ No newline at end of file
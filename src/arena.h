@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+
+// Allocations are aligned to this many bytes, enough for any vector type
+#define ArenaAlignment 16
+
+// A block of arena memory; allocations follow the header
+typedef struct ArenaBlock
+{
+    struct ArenaBlock* previous;
+    size_t capacity;
+    size_t used;
+} ArenaBlock;
+
+// A linear allocator: allocations are bumped from the newest block and freed together by
+// restoring a mark or resetting, never one at a time. A block is added when an allocation
+// does not fit, so the arena grows to the most it has held and then stops allocating
+typedef struct Arena
+{
+    ArenaBlock* block;
+    size_t blockSize; // Capacity of new blocks unless an allocation is larger
+    size_t totalCapacity;
+} Arena;
+
+// The position of an arena, returned to by ArenaRestore
+typedef struct ArenaMark
+{
+    ArenaBlock* block;
+    size_t used;
+} ArenaMark;
+
+void ArenaInitialize(Arena* arena, size_t blockSize);
+void* ArenaAlloc(Arena* arena, size_t size);
+ArenaMark ArenaSave(Arena* arena);
+
+// Frees everything allocated since the mark was saved; the first block is kept
+void ArenaRestore(Arena* arena, ArenaMark mark);
+
+// Frees every allocation, merging the blocks into one large enough for all of them
+void ArenaReset(Arena* arena);
+void ArenaDelete(Arena* arena);
+
+// Returns the calling thread's arena for temporaries, such as files read while loading
+// Save a mark before allocating and restore it before returning
+Arena* ArenaScratch();
+
+// Allocates from the frame arena, which is freed at the end of every frame by the main
+// loop; only the main thread may allocate from it
+void* ArenaFrameAlloc(size_t size);
+void ArenaFrameReset();
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cglm\cglm.h>
+#include "benchmark.h"
+#include "camera.h"
+#include "debug.h"
+#include "timer.h"
+
+#define MaxWarmupFrames 60
+#define HistogramBins 10
+#define HistogramWidth 40
+
+void BenchmarkInitialize(Benchmark* benchmark, unsigned long frameCount)
+{
+    memset(benchmark, 0, sizeof(Benchmark));
+    benchmark->warmupFrames = frameCount / 10;
+    if (benchmark->warmupFrames > MaxWarmupFrames) benchmark->warmupFrames = MaxWarmupFrames;
+
+    benchmark->capacity = frameCount - benchmark->warmupFrames;
+    benchmark->frameTimes = malloc(benchmark->capacity * sizeof(double));
+}
+
+void BenchmarkAddFrame(Benchmark* benchmark, double frameTime)
+{
+    if (benchmark->seenFrames++ < benchmark->warmupFrames) return;
+    if (benchmark->frameCount == benchmark->capacity) return;
+
+    benchmark->frameTimes[benchmark->frameCount++] = frameTime;
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of sorted samples, matching the profiler's
+static double Percentile(const double* sorted, unsigned long count, unsigned int percent)
+{
+    return sorted[(count * percent + 99) / 100 - 1];
+}
+
+void BenchmarkPrintSummary(const Benchmark* benchmark)
+{
+    unsigned long count = benchmark->frameCount;
+    if (count == 0) return;
+
+    double* sorted = malloc(count * sizeof(double));
+    memcpy(sorted, benchmark->frameTimes, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), CompareDoubles);
+
+    double total = 0.0;
+    for (unsigned long i = 0; i < count; i++) total += sorted[i];
+    double avg = total / count;
+
+    double variance = 0.0;
+    for (unsigned long i = 0; i < count; i++) variance += (sorted[i] - avg) * (sorted[i] - avg);
+    double deviation = sqrt(variance / count);
+
+    double min = sorted[0];
+    double max = sorted[count - 1];
+    double p50 = Percentile(sorted, count, 50);
+    double p90 = Percentile(sorted, count, 90);
+    double p99 = Percentile(sorted, count, 99);
+
+    printf("Benchmark: %lu frames after %lu warmup frames (GL errors: %s)\n", count,
+        benchmark->warmupFrames, DebugErrorModeName());
+    printf("  Frame time ms: min %.3f  avg %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f  stddev %.3f\n",
+        min * 1000.0, avg * 1000.0, p50 * 1000.0, p90 * 1000.0, p99 * 1000.0, max * 1000.0,
+        deviation * 1000.0);
+    printf("  Frames per second: %.1f\n", count / total);
+
+    // Equal width bins from the fastest to the slowest frame
+    unsigned long bins[HistogramBins] = { 0 };
+    unsigned long largestBin = 0;
+    double binWidth = (max - min) / HistogramBins;
+    for (unsigned long i = 0; i < count; i++)
+    {
+        int bin = binWidth > 0.0 ? (int)((sorted[i] - min) / binWidth) : 0;
+        if (bin >= HistogramBins) bin = HistogramBins - 1;
+        bins[bin]++;
+        if (bins[bin] > largestBin) largestBin = bins[bin];
+    }
+
+    for (int bin = 0; bin < HistogramBins; bin++)
+    {
+        char bar[HistogramWidth + 1];
+        int length = (int)((bins[bin] * HistogramWidth + largestBin - 1) / largestBin);
+        memset(bar, '#', length);
+        bar[length] = '\0';
+
+        printf("  %8.3f - %8.3f ms | %-*s %lu\n", (min + bin * binWidth) * 1000.0,
+            (min + (bin + 1) * binWidth) * 1000.0, HistogramWidth, bar, bins[bin]);
+    }
+
+    // GPU times come from the profiler's recent frames rather than the whole run
+    TimerStats gpu = { 0 };
+    TimerGetZoneStats("Frame", &gpu, NULL);
+
+    printf("BENCHMARK frames=%lu min_ms=%.3f avg_ms=%.3f p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f max_ms=%.3f "
+        "stddev_ms=%.3f fps=%.1f gpu_avg_ms=%.3f gpu_p99_ms=%.3f\n",
+        count, min * 1000.0, avg * 1000.0, p50 * 1000.0, p90 * 1000.0, p99 * 1000.0, max * 1000.0,
+        deviation * 1000.0, count / total, gpu.avg, gpu.p99);
+
+    free(sorted);
+}
+
+void BenchmarkDelete(Benchmark* benchmark)
+{
+    free(benchmark->frameTimes);
+    benchmark->frameTimes = NULL;
+}
+
+void BenchmarkMoveCamera(double time, float radius)
+{
+    float angle = (float)(2.0 * GLM_PI * fmod(time, BenchmarkOrbitPeriod) / BenchmarkOrbitPeriod);
+    float height = radius * (0.4f + 0.2f * sinf(2.0f * angle));
+
+    vec3 position = { radius * sinf(angle), height, -radius * cosf(angle) };
+    vec3 translation;
+    CameraPosition(translation);
+    glm_vec3_sub(position, translation, translation);
+    CameraTranslate(translation);
+
+    // The camera looks along its forward axis, which CameraRotate points at
+    // (sin(yaw) cos(pitch), -sin(pitch), cos(yaw) cos(pitch))
+    vec3 forward;
+    glm_vec3_scale(position, -1.0f, forward);
+    glm_vec3_normalize(forward);
+
+    float yaw = glm_deg(atan2f(forward[0], forward[2]));
+    float pitch = glm_deg(-asinf(forward[1]));
+    CameraRotate(yaw, pitch, 0.0f);
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+// Seconds of simulation time the scripted camera takes to orbit the scene once
+#define BenchmarkOrbitPeriod 10.0
+
+// Frame times of a benchmark run, summarized when it ends
+typedef struct Benchmark
+{
+    double* frameTimes; // Seconds from the start to the end of each frame, swap included
+    unsigned long frameCount;
+    unsigned long capacity;
+    unsigned long warmupFrames; // Leading frames left out of the summary
+    unsigned long seenFrames;
+} Benchmark;
+
+// Prepares to record a run of frameCount frames; the first tenth of them, up to 60,
+// are treated as warmup while shaders compile and caches fill
+void BenchmarkInitialize(Benchmark* benchmark, unsigned long frameCount);
+void BenchmarkAddFrame(Benchmark* benchmark, double frameTime);
+
+// Prints the distribution of frame times as percentiles and a histogram, followed by a
+// single line of key=value pairs starting with "BENCHMARK" for scripts to compare
+void BenchmarkPrintSummary(const Benchmark* benchmark);
+void BenchmarkDelete(Benchmark* benchmark);
+
+// Places the camera on the scripted path at the given simulation time: an orbit of the
+// origin at the given radius that rises and falls twice per orbit
+void BenchmarkMoveCamera(double time, float radius);
\ No newline at end of file
@@ -141,6 +141,12 @@ void CameraViewMatrix(mat4 dest)
     dest[3][3] = 1.0f;
 }
 
+// Copies the position of the camera in world space
+void CameraPosition(vec3 dest)
+{
+    glm_vec3_copy(position, dest);
+}
+
 // Computes the camera matrix of the camera (inverse of view matrix)
 void CameraCameraMatrix(mat4 dest)
 {
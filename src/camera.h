@@ -6,6 +6,7 @@ void CameraViewPerspectiveMatrix(mat4 dest);
 void CameraUseOrthographic(float aspectRatio, float size);
 void CameraUsePerspective(float fovY, float aspectRatio, float nearClip, float farClip);
 void CameraViewMatrix(mat4 dest);
+void CameraPosition(vec3 dest);
 void CameraTranslate(vec3 translation);
 void CameraTranslateRelative(vec3 translation);
 void CameraOrthographicZoom(float size);
@@ -0,0 +1,389 @@
+#define GLEW_STATIC
+#include <GL\glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "capture.h"
+#include "renderer.h"
+#include "parallel.h"
+#include "timer.h"
+#include "debug.h"
+
+// Pipes are opened in binary mode on Windows, where text mode would rewrite newlines in frames
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PipeWriteMode "wb"
+#else
+#include <signal.h>
+#define PipeWriteMode "w"
+#endif
+
+static double Seconds()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Flips a frame to top down RGB and encodes it into its slot
+static void EncodeSlot(FrameCapture* capture, CaptureSlot* slot, unsigned char* pixels)
+{
+    int width = capture->width;
+    int height = capture->height;
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* source = slot->rgba + (size_t)(height - 1 - y) * width * 4;
+        unsigned char* destination = pixels + (size_t)y * width * 3;
+        for (int x = 0; x < width; x++)
+        {
+            destination[x * 3] = source[x * 4];
+            destination[x * 3 + 1] = source[x * 4 + 1];
+            destination[x * 3 + 2] = source[x * 4 + 2];
+        }
+    }
+
+    slot->encoded.length = 0;
+    ImageEncode(&slot->encoded, capture->format, pixels, width, height);
+}
+
+// Encodes queued frames in any order
+static void* RunEncoder(void* arg)
+{
+    FrameCapture* capture = arg;
+    unsigned char* pixels = malloc((size_t)capture->width * capture->height * 3);
+
+    pthread_mutex_lock(&capture->mutex);
+    while (true)
+    {
+        while (capture->encodeNext == capture->queuedCount && !capture->finishing)
+        {
+            pthread_cond_wait(&capture->changed, &capture->mutex);
+        }
+
+        if (capture->encodeNext == capture->queuedCount) break;
+
+        CaptureSlot* slot = &capture->slots[capture->encodeNext++ % capture->slotCount];
+        slot->state = CaptureSlotEncoding;
+        pthread_mutex_unlock(&capture->mutex);
+
+        TimerTraceBegin("Encode frame");
+        EncodeSlot(capture, slot, pixels);
+        TimerTraceEnd();
+
+        pthread_mutex_lock(&capture->mutex);
+        slot->state = CaptureSlotEncoded;
+        pthread_cond_broadcast(&capture->changed);
+    }
+    pthread_mutex_unlock(&capture->mutex);
+
+    free(pixels);
+    return NULL;
+}
+
+// Returns false if the frame could not be written
+static bool WriteSlot(FrameCapture* capture, CaptureSlot* slot)
+{
+    const ImageBuffer* encoded = &slot->encoded;
+    if (capture->stream)
+    {
+        return fwrite(encoded->data, 1, encoded->length, capture->stream) == encoded->length;
+    }
+
+    char filePath[1024];
+    snprintf(filePath, sizeof(filePath), capture->zeroPadded ? "%s%0*lu%s" : "%s%*lu%s",
+        capture->namePrefix, capture->numberWidth, slot->frameNumber, capture->nameSuffix);
+
+    FILE* file = fopen(filePath, "wb");
+    if (file == NULL)
+    {
+        printf("Error opening file at path: %s\n", filePath);
+        return false;
+    }
+
+    bool written = fwrite(encoded->data, 1, encoded->length, file) == encoded->length;
+    return fclose(file) == 0 && written;
+}
+
+// Writes encoded frames in the order they were captured
+static void* RunWriter(void* arg)
+{
+    FrameCapture* capture = arg;
+
+    pthread_mutex_lock(&capture->mutex);
+    while (true)
+    {
+        CaptureSlot* slot = &capture->slots[capture->writtenCount % capture->slotCount];
+        while (!(capture->writtenCount < capture->queuedCount && slot->state == CaptureSlotEncoded)
+            && !(capture->finishing && capture->writtenCount == capture->queuedCount))
+        {
+            pthread_cond_wait(&capture->changed, &capture->mutex);
+        }
+
+        if (capture->writtenCount == capture->queuedCount) break;
+
+        bool failed = capture->failed;
+        pthread_mutex_unlock(&capture->mutex);
+
+        if (!failed)
+        {
+            TimerTraceBegin("Write frame");
+            failed = !WriteSlot(capture, slot);
+            TimerTraceEnd();
+        }
+
+        pthread_mutex_lock(&capture->mutex);
+        capture->failed = failed;
+        slot->state = CaptureSlotFree;
+        capture->writtenCount++;
+        pthread_cond_broadcast(&capture->changed);
+    }
+    pthread_mutex_unlock(&capture->mutex);
+
+    return NULL;
+}
+
+// Splits a file pattern such as "frames/%05lu.png" around its one integer conversion,
+// writing %% in the rest of the pattern as %
+// Returns false if the pattern has no conversion, more than one, or one of another kind
+static bool ParseFilePattern(FrameCapture* capture, const char* filePattern)
+{
+    size_t length = strlen(filePattern);
+    char* prefix = malloc(length + 1);
+    char* suffix = malloc(length + 1);
+    char* out = prefix;
+    bool found = false;
+
+    for (const char* c = filePattern; *c; c++)
+    {
+        if (*c != '%')
+        {
+            *out++ = *c;
+            continue;
+        }
+
+        c++;
+        if (*c == '%')
+        {
+            *out++ = '%';
+            continue;
+        }
+
+        bool zeroPadded = *c == '0';
+        if (zeroPadded) c++;
+
+        int width = 0;
+        while (*c >= '0' && *c <= '9' && width < 100) width = width * 10 + (*c++ - '0');
+
+        int longCount = 0;
+        while (*c == 'l' && longCount < 2) c++, longCount++;
+
+        if (found || width >= 100 || *c == '\0' || strchr("diu", *c) == NULL)
+        {
+            free(prefix);
+            free(suffix);
+            return false;
+        }
+
+        found = true;
+        capture->zeroPadded = zeroPadded;
+        capture->numberWidth = width;
+        *out = '\0';
+        out = suffix;
+    }
+
+    *out = '\0';
+    if (!found)
+    {
+        free(prefix);
+        free(suffix);
+        return false;
+    }
+
+    capture->namePrefix = prefix;
+    capture->nameSuffix = suffix;
+    return true;
+}
+
+bool CaptureInitialize(FrameCapture* capture, int width, int height, const char* filePattern,
+    double frameRate)
+{
+    memset(capture, 0, sizeof(FrameCapture));
+    capture->width = width;
+    capture->height = height;
+    capture->piped = filePattern[0] == '|';
+    capture->format = capture->piped ? ImageFormatY4M : ImageFormatFromPath(filePattern);
+    capture->filePattern = strdup(filePattern);
+
+    if (capture->format != ImageFormatY4M && !ParseFilePattern(capture, filePattern))
+    {
+        printf("Capture pattern '%s' needs one integer conversion for the frame number, e.g. %%05lu\n",
+            filePattern);
+        free(capture->filePattern);
+        return false;
+    }
+
+    if (capture->format == ImageFormatY4M)
+    {
+#ifndef _WIN32
+        // A command that exits early then fails the write instead of killing the viewer
+        if (capture->piped) signal(SIGPIPE, SIG_IGN);
+#endif
+        capture->stream = capture->piped ? popen(filePattern + 1, PipeWriteMode) : fopen(filePattern, "wb");
+        if (capture->stream == NULL)
+        {
+            printf("Error opening capture output: %s\n", filePattern);
+            free(capture->filePattern);
+            return false;
+        }
+
+        ImageBuffer header = { 0 };
+        ImageY4MHeader(&header, width, height, frameRate);
+        fwrite(header.data, 1, header.length, capture->stream);
+        ImageBufferFree(&header);
+    }
+
+    size_t size = (size_t)width * height * 4;
+    GLCall(glGenBuffers(2, capture->packBufferIds));
+    for (int i = 0; i < 2; i++)
+    {
+        RendererBindBuffer(GL_PIXEL_PACK_BUFFER, capture->packBufferIds[i]);
+        GLCall(glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ));
+    }
+
+    RendererBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // The render thread keeps one core; the encoders take the rest
+    unsigned int threadCount = ParallelThreadCount();
+    capture->workerCount = threadCount > 1 ? threadCount - 1 : 1;
+    if (capture->workerCount > CaptureMaxWorkers) capture->workerCount = CaptureMaxWorkers;
+
+    // Enough slots for every encoder to be busy while one frame is written and one queued
+    capture->slotCount = capture->workerCount + 2;
+    capture->slots = calloc(capture->slotCount, sizeof(CaptureSlot));
+    for (unsigned int i = 0; i < capture->slotCount; i++)
+    {
+        capture->slots[i].rgba = malloc(size);
+    }
+
+    pthread_mutex_init(&capture->mutex, NULL);
+    pthread_cond_init(&capture->changed, NULL);
+    for (unsigned int i = 0; i < capture->workerCount; i++)
+    {
+        pthread_create(&capture->workers[i], NULL, RunEncoder, capture);
+    }
+
+    pthread_create(&capture->writer, NULL, RunWriter, capture);
+    return true;
+}
+
+// Copies a mapped frame into the next slot, waiting for the slot to be written if needed
+static void QueueFrame(FrameCapture* capture, const unsigned char* rgba)
+{
+    CaptureSlot* slot = &capture->slots[capture->queuedCount % capture->slotCount];
+
+    pthread_mutex_lock(&capture->mutex);
+    if (slot->state != CaptureSlotFree)
+    {
+        double waitStart = Seconds();
+        while (slot->state != CaptureSlotFree)
+        {
+            pthread_cond_wait(&capture->changed, &capture->mutex);
+        }
+
+        capture->waitTime += Seconds() - waitStart;
+    }
+    pthread_mutex_unlock(&capture->mutex);
+
+    // Free slots are not touched by the other threads
+    memcpy(slot->rgba, rgba, (size_t)capture->width * capture->height * 4);
+
+    pthread_mutex_lock(&capture->mutex);
+    if (capture->queuedCount == 0) capture->startTime = Seconds();
+    slot->frameNumber = capture->queuedCount++;
+    slot->state = CaptureSlotQueued;
+    pthread_cond_broadcast(&capture->changed);
+    pthread_mutex_unlock(&capture->mutex);
+}
+
+// Maps a finished read and hands it to the pipeline
+static void QueueRead(FrameCapture* capture, int slot)
+{
+    RendererBindBuffer(GL_PIXEL_PACK_BUFFER, capture->packBufferIds[slot]);
+    const unsigned char* rgba;
+    GLCall(rgba = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+
+    if (rgba)
+    {
+        QueueFrame(capture, rgba);
+        GLCall(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+    }
+
+    capture->pending[slot] = false;
+}
+
+void CaptureFrame(FrameCapture* capture)
+{
+    int slot = capture->readCount++ % 2;
+
+    RendererBindBuffer(GL_PIXEL_PACK_BUFFER, capture->packBufferIds[slot]);
+    GLCall(glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, 0));
+    capture->pending[slot] = true;
+
+    // The other buffer was read a frame ago and is usually ready to map without waiting
+    if (capture->pending[!slot]) QueueRead(capture, !slot);
+
+    RendererBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void CaptureFinish(FrameCapture* capture)
+{
+    int last = (capture->readCount + 1) % 2;
+    if (capture->pending[!last]) QueueRead(capture, !last);
+    if (capture->pending[last]) QueueRead(capture, last);
+
+    RendererBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    RendererForgetBuffer(capture->packBufferIds[0]);
+    RendererForgetBuffer(capture->packBufferIds[1]);
+    GLCall(glDeleteBuffers(2, capture->packBufferIds));
+
+    pthread_mutex_lock(&capture->mutex);
+    capture->finishing = true;
+    pthread_cond_broadcast(&capture->changed);
+    pthread_mutex_unlock(&capture->mutex);
+
+    for (unsigned int i = 0; i < capture->workerCount; i++)
+    {
+        pthread_join(capture->workers[i], NULL);
+    }
+
+    pthread_join(capture->writer, NULL);
+    double elapsed = Seconds() - capture->startTime;
+
+    if (capture->stream)
+    {
+        if (capture->piped) pclose(capture->stream);
+        else fclose(capture->stream);
+    }
+
+    if (capture->failed) printf("Writing captured frames failed; later frames were dropped\n");
+
+    printf("Wrote %lu frames to '%s' at %.1f frames/s with %u encoders (capture waited %.1f ms)\n",
+        capture->writtenCount, capture->filePattern,
+        elapsed > 0.0 ? capture->writtenCount / elapsed : 0.0, capture->workerCount,
+        capture->waitTime * 1000.0);
+
+    for (unsigned int i = 0; i < capture->slotCount; i++)
+    {
+        free(capture->slots[i].rgba);
+        ImageBufferFree(&capture->slots[i].encoded);
+    }
+
+    free(capture->slots);
+    free(capture->filePattern);
+    free(capture->namePrefix);
+    free(capture->nameSuffix);
+    pthread_mutex_destroy(&capture->mutex);
+    pthread_cond_destroy(&capture->changed);
+}
\ No newline at end of file
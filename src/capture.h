@@ -0,0 +1,77 @@
+#pragma once
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "image.h"
+
+#define CaptureMaxWorkers 16
+
+typedef enum CaptureSlotState
+{
+    CaptureSlotFree,
+    CaptureSlotQueued, // Waiting for an encoder
+    CaptureSlotEncoding,
+    CaptureSlotEncoded, // Waiting for the writer
+} CaptureSlotState;
+
+// A frame on its way through the pipeline; frame k always uses slot k % slotCount
+typedef struct CaptureSlot
+{
+    CaptureSlotState state;
+    unsigned long frameNumber;
+    unsigned char* rgba; // As read back, bottom row first
+    ImageBuffer encoded;
+} CaptureSlot;
+
+// Writes rendered frames to numbered image files or to a Y4M video stream
+// Each frame is read into one of two pixel pack buffers and mapped on the next frame, so
+// reading it back does not wait for the GPU to finish rendering it. Mapped frames are
+// encoded by worker threads and written in order by a writer thread; capturing only
+// waits when every slot of the pipeline is still being encoded or written
+typedef struct FrameCapture
+{
+    unsigned int packBufferIds[2];
+    bool pending[2];
+    unsigned long readCount; // Frames read into the pack buffers
+    int width;
+    int height;
+
+    // A pattern with one integer conversion for the frame number, such as "frames/%05lu.png",
+    // a .y4m file, or a command reading a Y4M stream from its input if it starts with '|'
+    char* filePattern;
+
+    // Frame files are named by the prefix, the frame number padded to numberWidth and the suffix
+    char* namePrefix;
+    char* nameSuffix;
+    int numberWidth;
+    bool zeroPadded;
+    ImageFormat format;
+    FILE* stream; // Y4M output
+    bool piped;
+
+    CaptureSlot* slots;
+    unsigned int slotCount;
+    unsigned long queuedCount; // Frames handed to the encoders
+    unsigned long encodeNext; // The next frame for an encoder to take
+    unsigned long writtenCount;
+    bool finishing;
+    bool failed; // Writing failed; later frames are encoded but dropped
+    pthread_mutex_t mutex;
+    pthread_cond_t changed; // Broadcast whenever a slot changes state
+    pthread_t workers[CaptureMaxWorkers];
+    unsigned int workerCount;
+    pthread_t writer;
+
+    double startTime; // When the first frame was queued, in seconds
+    double waitTime; // Time spent waiting for a free slot
+} FrameCapture;
+
+// Returns false if the output cannot be opened
+bool CaptureInitialize(FrameCapture* capture, int width, int height, const char* filePattern,
+    double frameRate);
+
+// Reads back the color of the bound read framebuffer
+void CaptureFrame(FrameCapture* capture);
+
+// Writes the frames still in the pipeline, reports the throughput and deletes the capture
+void CaptureFinish(FrameCapture* capture);
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include <string.h>
+#include <stdlib.h>
+#include <cglm\cglm.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "cull.h"
+#include "parallel.h"
+#include "arena.h"
+
+// Instances are bounded and tested in batches small enough for the stack
+#define CullBatchSize 64
+
+// Instances are split into chunks that are culled and compacted independently
+#define CullChunkSize 4096
+
+// The minimum number of chunks given to a thread
+#define CullChunksPerThread 4
+
+typedef struct CullContext
+{
+    const Frustum* frustum;
+    CullBoundsFunction bounds;
+    const char* instances;
+    unsigned int count;
+    unsigned int stride;
+    char* dest;
+    unsigned char* visibleFlags; // Visibility of each instance
+    unsigned int* chunkOffsets; // Visible count, then write offset, of each chunk
+} CullContext;
+
+// Extracts the clip planes of the frustum defined by a view-perspective matrix
+void FrustumFromMatrix(mat4 vpMatrix, Frustum* frustum)
+{
+    glm_frustum_planes(vpMatrix, frustum->planes);
+}
+
+// Tests `count` spheres against the frustum, setting `visible[i]` to one for
+// spheres that intersect it and zero otherwise
+// The arrays must be padded to a multiple of four elements
+// Returns the number of visible spheres
+static unsigned int CullSpheres(const Frustum* frustum, const float* x, const float* y,
+    const float* z, const float* radius, unsigned int count, unsigned char* visible)
+{
+    unsigned int visibleCount = 0;
+
+#ifdef __SSE__
+    __m128 planes[6][4];
+    for (int p = 0; p < 6; p++)
+    {
+        for (int i = 0; i < 4; i++) planes[p][i] = _mm_set1_ps(frustum->planes[p][i]);
+    }
+
+    for (unsigned int i = 0; i < count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 inside = _mm_cmpeq_ps(px, px); // all lanes set
+
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(planes[p][0], px), planes[p][3]);
+            distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][1], py));
+            distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][2], pz));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        unsigned int lanes = count - i < 4 ? count - i : 4;
+        for (unsigned int lane = 0; lane < lanes; lane++)
+        {
+            visible[i + lane] = (mask >> lane) & 1;
+            visibleCount += visible[i + lane];
+        }
+    }
+#else
+    for (unsigned int i = 0; i < count; i++)
+    {
+        int inside = 1;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            const float* plane = frustum->planes[p];
+            float distance = plane[0] * x[i] + plane[1] * y[i] + plane[2] * z[i] + plane[3];
+            inside = distance >= -radius[i];
+        }
+
+        visible[i] = inside;
+        visibleCount += inside;
+    }
+#endif
+
+    return visibleCount;
+}
+
+// Computes the visibility of every instance in a range of chunks
+static void TestChunks(unsigned int startChunk, unsigned int endChunk, void* context)
+{
+    CullContext* cull = context;
+    float x[CullBatchSize], y[CullBatchSize], z[CullBatchSize], radius[CullBatchSize];
+
+    for (unsigned int chunk = startChunk; chunk < endChunk; chunk++)
+    {
+        unsigned int start = chunk * CullChunkSize;
+        unsigned int end = start + CullChunkSize < cull->count ? start + CullChunkSize : cull->count;
+        unsigned int visibleCount = 0;
+
+        for (unsigned int i = start; i < end; i += CullBatchSize)
+        {
+            unsigned int batchCount = end - i < CullBatchSize ? end - i : CullBatchSize;
+            cull->bounds(cull->instances + (size_t)i * cull->stride, batchCount, x, y, z, radius);
+            visibleCount += CullSpheres(cull->frustum, x, y, z, radius, batchCount, cull->visibleFlags + i);
+        }
+
+        cull->chunkOffsets[chunk] = visibleCount;
+    }
+}
+
+// Copies the visible instances of a range of chunks to their compacted positions
+static void CompactChunks(unsigned int startChunk, unsigned int endChunk, void* context)
+{
+    CullContext* cull = context;
+    unsigned int stride = cull->stride;
+
+    for (unsigned int chunk = startChunk; chunk < endChunk; chunk++)
+    {
+        unsigned int start = chunk * CullChunkSize;
+        unsigned int end = start + CullChunkSize < cull->count ? start + CullChunkSize : cull->count;
+        char* write = cull->dest + (size_t)cull->chunkOffsets[chunk] * stride;
+
+        for (unsigned int i = start; i < end; i++)
+        {
+            if (!cull->visibleFlags[i]) continue;
+
+            memcpy(write, cull->instances + (size_t)i * stride, stride);
+            write += stride;
+        }
+    }
+}
+
+// Copies the instances whose bounding spheres intersect the frustum to `dest`,
+// preserving their order. `instances` and `dest` must not overlap
+// Large instance counts are culled on multiple threads
+// Temporaries come from the frame arena, so only the main thread may cull
+// Returns the number of visible instances
+unsigned int CullInstances(const Frustum* frustum, CullBoundsFunction bounds,
+    const void* instances, unsigned int count, unsigned int stride, void* dest)
+{
+    if (count == 0) return 0;
+
+    unsigned int chunkCount = (count + CullChunkSize - 1) / CullChunkSize;
+
+    // Flags are padded to the SIMD width
+    unsigned char* visibleFlags = ArenaFrameAlloc(count + 4);
+    unsigned int* chunkOffsets = ArenaFrameAlloc(sizeof(unsigned int) * chunkCount);
+
+    CullContext context = { frustum, bounds, instances, count, stride, dest, visibleFlags, chunkOffsets };
+
+    ParallelFor(chunkCount, CullChunksPerThread, TestChunks, &context);
+
+    // Turn the visible counts of each chunk into write offsets
+    unsigned int visibleCount = 0;
+    for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+    {
+        unsigned int chunkVisible = chunkOffsets[chunk];
+        chunkOffsets[chunk] = visibleCount;
+        visibleCount += chunkVisible;
+    }
+
+    ParallelFor(chunkCount, CullChunksPerThread, CompactChunks, &context);
+
+    return visibleCount;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cglm\cglm.h>
+
+typedef struct Frustum
+{
+    vec4 planes[6]; // Normalized (normal, distance); points inside have a non-negative distance
+} Frustum;
+
+// Writes the bounding spheres of `count` instances starting at `instances`
+// into the arrays x, y, z (center) and radius
+typedef void (*CullBoundsFunction)(const void* instances, unsigned int count,
+    float* x, float* y, float* z, float* radius);
+
+void FrustumFromMatrix(mat4 vpMatrix, Frustum* frustum);
+
+unsigned int CullInstances(const Frustum* frustum, CullBoundsFunction bounds,
+    const void* instances, unsigned int count, unsigned int stride, void* dest);
\ No newline at end of file
@@ -4,6 +4,72 @@
 #include <stdio.h>
 #include "debug.h"
 
+_Thread_local GLCallSiteInfo GLCallSite;
+
+#if !defined(GL_ERRORS_NONE) && !defined(GL_ERRORS_POLL)
+static const char* DebugSourceName(GLenum source)
+{
+    switch (source)
+    {
+        case GL_DEBUG_SOURCE_API: return "API";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+        case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        default: return "other";
+    }
+}
+
+static void GLAPIENTRY DebugMessageCallback(GLenum source, GLenum type, GLuint id,
+    GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
+{
+    printf("OpenGL %s message (0x%x): %s\n", DebugSourceName(source), id, message);
+
+    // Shader compile errors are reported with their info log by ShaderCompile
+    if (type != GL_DEBUG_TYPE_ERROR || source != GL_DEBUG_SOURCE_API) return;
+
+    // Output is synchronous, so the last recorded call site is the offending call
+    if (GLCallSite.function != NULL)
+    {
+        printf("    after %s in %s:%d\n", GLCallSite.function, GLCallSite.file, GLCallSite.line);
+    }
+
+    __builtin_trap();
+}
+#endif
+
+// Sets up OpenGL error reporting for the selected error mode
+// Must be called after the context is created and glew is initialized
+void DebugInitialize()
+{
+#if !defined(GL_ERRORS_NONE) && !defined(GL_ERRORS_POLL)
+    if (!GLEW_VERSION_4_3 && !GLEW_KHR_debug)
+    {
+        printf("GL_KHR_debug is not supported; OpenGL errors will not be reported\n");
+        return;
+    }
+
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageCallback(DebugMessageCallback, NULL);
+
+    // Notifications (buffer placement hints and the like) are too noisy to be useful
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION,
+        0, NULL, GL_FALSE);
+#endif
+}
+
+const char* DebugErrorModeName()
+{
+#if defined(GL_ERRORS_NONE)
+    return "none";
+#elif defined(GL_ERRORS_POLL)
+    return "poll";
+#else
+    return "callback";
+#endif
+}
+
 void GLClearErrors()
 {
     while (glGetError() != GL_NO_ERROR)
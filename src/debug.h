@@ -2,11 +2,42 @@
 
 #include <cglm\cglm.h>
 
+// OpenGL error checking is selected at compile time:
+// -DGL_ERRORS_NONE (implied by -DNDEBUG): GLCall compiles to the bare call
+// -DGL_ERRORS_POLL: glGetError is polled around every call
+// Default: errors are reported by a GL_KHR_debug message callback, see DebugInitialize
+#if defined(NDEBUG) && !defined(GL_ERRORS_POLL) && !defined(GL_ERRORS_NONE)
+#define GL_ERRORS_NONE
+#endif
+
 #define ASSERT(x) if(!(x)) __builtin_trap();
+
+#if defined(GL_ERRORS_NONE)
+#define GLCall(x) x
+#elif defined(GL_ERRORS_POLL)
 #define GLCall(x) GLClearErrors();\
     x;\
     ASSERT(GLLogCall(#x, __FILE__, __LINE__))
+#else
+// Records the call site so that the debug callback can report it
+#define GLCall(x) GLCallSite.function = #x;\
+    GLCallSite.file = __FILE__;\
+    GLCallSite.line = __LINE__;\
+    x
+#endif
+
+typedef struct GLCallSiteInfo
+{
+    const char* function;
+    const char* file;
+    int line;
+} GLCallSiteInfo;
+
+// Each thread making GL calls records its own call sites
+extern _Thread_local GLCallSiteInfo GLCallSite;
 
+void DebugInitialize();
+const char* DebugErrorModeName();
 void GLClearErrors();
 int GLLogCall(const char* function, const char* file, int line);
 void LogVec2(vec2 v);
@@ -0,0 +1,443 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "image.h"
+
+// Deflate matches reach back at most this far and are at most this long
+#define DeflateWindowSize 32768
+#define DeflateMinMatch 3
+#define DeflateMaxMatch 258
+#define DeflateHashBits 15
+
+// Bytes that can be added to an Adler-32 sum before it may overflow 32 bits
+#define AdlerMaxUnreduced 5552
+
+static const unsigned short LengthBases[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115,
+    131, 163, 195, 227, 258
+};
+
+static const unsigned char LengthExtraBits[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short DistanceBases[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+    2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const unsigned char DistanceExtraBits[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Fixed Huffman codes of the literal/length alphabet, bit reversed for writing LSB first
+static unsigned short literalCodes[288];
+static unsigned char literalCodeLengths[288];
+static unsigned char lengthSymbols[DeflateMaxMatch + 1];
+static uint32_t crcTable[256];
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+// Writes bits into a buffer least significant first, as deflate requires
+typedef struct BitWriter
+{
+    ImageBuffer* buffer;
+    uint64_t bits;
+    unsigned int count;
+} BitWriter;
+
+static void Reserve(ImageBuffer* buffer, size_t length)
+{
+    if (buffer->length + length <= buffer->capacity) return;
+
+    size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+    while (capacity < buffer->length + length)
+    {
+        capacity *= 2;
+    }
+
+    buffer->data = realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+static void Append(ImageBuffer* buffer, const void* data, size_t length)
+{
+    Reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void AppendBigEndian(ImageBuffer* buffer, uint32_t value)
+{
+    unsigned char bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+    Append(buffer, bytes, 4);
+}
+
+void ImageBufferFree(ImageBuffer* buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+static unsigned int ReverseBits(unsigned int code, unsigned int length)
+{
+    unsigned int reversed = 0;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+
+    return reversed;
+}
+
+// Builds the CRC and fixed Huffman tables, once for every thread
+static void InitializeTables()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+
+        crcTable[i] = c;
+    }
+
+    for (unsigned int symbol = 0; symbol < 288; symbol++)
+    {
+        unsigned int code, length;
+        if (symbol < 144) code = 0x30 + symbol, length = 8;
+        else if (symbol < 256) code = 0x190 + symbol - 144, length = 9;
+        else if (symbol < 280) code = symbol - 256, length = 7;
+        else code = 0xC0 + symbol - 280, length = 8;
+
+        literalCodes[symbol] = ReverseBits(code, length);
+        literalCodeLengths[symbol] = length;
+    }
+
+    for (unsigned int symbol = 0; symbol < 29; symbol++)
+    {
+        unsigned int end = symbol == 28 ? DeflateMaxMatch + 1 : LengthBases[symbol + 1];
+        for (unsigned int length = LengthBases[symbol]; length < end; length++)
+        {
+            lengthSymbols[length] = symbol;
+        }
+    }
+}
+
+static uint32_t UpdateCrc(uint32_t crc, const unsigned char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static uint32_t Adler32(const unsigned char* data, size_t length)
+{
+    uint32_t a = 1, b = 0;
+    while (length > 0)
+    {
+        size_t count = length < AdlerMaxUnreduced ? length : AdlerMaxUnreduced;
+        for (size_t i = 0; i < count; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+        data += count;
+        length -= count;
+    }
+
+    return (b << 16) | a;
+}
+
+static void PutBits(BitWriter* writer, uint32_t value, unsigned int length)
+{
+    writer->bits |= (uint64_t)value << writer->count;
+    writer->count += length;
+
+    while (writer->count >= 8)
+    {
+        unsigned char byte = writer->bits;
+        Append(writer->buffer, &byte, 1);
+        writer->bits >>= 8;
+        writer->count -= 8;
+    }
+}
+
+static void PutLiteral(BitWriter* writer, unsigned int symbol)
+{
+    PutBits(writer, literalCodes[symbol], literalCodeLengths[symbol]);
+}
+
+static void PutMatch(BitWriter* writer, unsigned int length, unsigned int distance)
+{
+    unsigned int symbol = lengthSymbols[length];
+    PutLiteral(writer, 257 + symbol);
+    PutBits(writer, length - LengthBases[symbol], LengthExtraBits[symbol]);
+
+    unsigned int distanceSymbol = 29;
+    while (DistanceBases[distanceSymbol] > distance)
+    {
+        distanceSymbol--;
+    }
+
+    PutBits(writer, ReverseBits(distanceSymbol, 5), 5);
+    PutBits(writer, distance - DistanceBases[distanceSymbol], DistanceExtraBits[distanceSymbol]);
+}
+
+static unsigned int Hash(const unsigned char* data)
+{
+    uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+    return (value * 2654435761u) >> (32 - DeflateHashBits);
+}
+
+// Compresses data as a zlib stream with one fixed Huffman block
+// Matches are found greedily through the last position of each hashed 3 byte prefix
+static void Deflate(ImageBuffer* buffer, const unsigned char* data, size_t length)
+{
+    static const unsigned char ZlibHeader[2] = { 0x78, 0x01 };
+    Append(buffer, ZlibHeader, 2);
+
+    BitWriter writer = { buffer, 0, 0 };
+    PutBits(&writer, 1, 1); // Final block
+    PutBits(&writer, 1, 2); // Fixed Huffman codes
+
+    int32_t* heads = malloc(sizeof(int32_t) << DeflateHashBits);
+    memset(heads, 0xFF, sizeof(int32_t) << DeflateHashBits);
+
+    size_t i = 0;
+    while (i < length)
+    {
+        unsigned int matchLength = 0;
+        size_t matchPosition = 0;
+
+        if (i + DeflateMinMatch <= length)
+        {
+            unsigned int hash = Hash(data + i);
+            int32_t candidate = heads[hash];
+            heads[hash] = i;
+
+            if (candidate >= 0 && i - candidate <= DeflateWindowSize)
+            {
+                size_t maxLength = length - i < DeflateMaxMatch ? length - i : DeflateMaxMatch;
+                while (matchLength < maxLength && data[candidate + matchLength] == data[i + matchLength])
+                {
+                    matchLength++;
+                }
+
+                matchPosition = candidate;
+            }
+        }
+
+        if (matchLength < DeflateMinMatch)
+        {
+            PutLiteral(&writer, data[i]);
+            i++;
+            continue;
+        }
+
+        PutMatch(&writer, matchLength, i - matchPosition);
+
+        // Positions inside the match can still start later matches
+        size_t end = i + matchLength;
+        for (i++; i < end; i++)
+        {
+            if (i + DeflateMinMatch <= length) heads[Hash(data + i)] = i;
+        }
+    }
+
+    free(heads);
+
+    PutLiteral(&writer, 256); // End of block
+    PutBits(&writer, 0, 7); // Pads the last byte
+
+    AppendBigEndian(buffer, Adler32(data, length));
+}
+
+// Filters every row with the PNG Sub filter, which turns flat and smoothly shaded
+// areas into runs of small values that deflate compresses well
+static void EncodePNG(ImageBuffer* buffer, const unsigned char* pixels, int width, int height)
+{
+    static const unsigned char Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    Append(buffer, Signature, 8);
+
+    unsigned char header[17] = { 'I', 'H', 'D', 'R' };
+    uint32_t size[2] = { width, height };
+    for (int i = 0; i < 2; i++)
+    {
+        header[4 + i * 4] = size[i] >> 24;
+        header[5 + i * 4] = size[i] >> 16;
+        header[6 + i * 4] = size[i] >> 8;
+        header[7 + i * 4] = size[i];
+    }
+    header[12] = 8; // Bit depth
+    header[13] = 2; // Truecolor
+    header[14] = 0; // Deflate
+    header[15] = 0; // Adaptive filtering
+    header[16] = 0; // No interlacing
+    AppendBigEndian(buffer, 13);
+    Append(buffer, header, 17);
+    AppendBigEndian(buffer, UpdateCrc(0xFFFFFFFFu, header, 17) ^ 0xFFFFFFFFu);
+
+    size_t rowLength = (size_t)width * 3;
+    unsigned char* filtered = malloc((rowLength + 1) * height);
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* row = pixels + y * rowLength;
+        unsigned char* output = filtered + y * (rowLength + 1);
+        output[0] = 1; // Sub
+        memcpy(output + 1, row, 3);
+        for (size_t x = 3; x < rowLength; x++)
+        {
+            output[x + 1] = row[x] - row[x - 3];
+        }
+    }
+
+    size_t chunkStart = buffer->length;
+    AppendBigEndian(buffer, 0); // Length, known once compressed
+    Append(buffer, "IDAT", 4);
+    Deflate(buffer, filtered, (rowLength + 1) * height);
+    free(filtered);
+
+    uint32_t chunkLength = buffer->length - chunkStart - 8;
+    unsigned char* lengthBytes = buffer->data + chunkStart;
+    lengthBytes[0] = chunkLength >> 24;
+    lengthBytes[1] = chunkLength >> 16;
+    lengthBytes[2] = chunkLength >> 8;
+    lengthBytes[3] = chunkLength;
+    AppendBigEndian(buffer, UpdateCrc(0xFFFFFFFFu, buffer->data + chunkStart + 4, chunkLength + 4) ^ 0xFFFFFFFFu);
+
+    static const unsigned char End[12] = { 0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82 };
+    Append(buffer, End, 12);
+}
+
+static unsigned char ClampByte(int value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// Converts to full range BT.601 YCbCr with chroma averaged over 2x2 blocks (C420jpeg)
+static void EncodeY4MFrame(ImageBuffer* buffer, const unsigned char* pixels, int width, int height)
+{
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    size_t lumaSize = (size_t)width * height;
+    size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+
+    Append(buffer, "FRAME\n", 6);
+    Reserve(buffer, lumaSize + chromaSize * 2);
+    unsigned char* luma = buffer->data + buffer->length;
+    unsigned char* cb = luma + lumaSize;
+    unsigned char* cr = cb + chromaSize;
+    buffer->length += lumaSize + chromaSize * 2;
+
+    // Coefficients are scaled by 2^16
+    for (size_t i = 0; i < lumaSize; i++)
+    {
+        const unsigned char* p = pixels + i * 3;
+        luma[i] = (19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768) >> 16;
+    }
+
+    for (int y = 0; y < chromaHeight; y++)
+    {
+        for (int x = 0; x < chromaWidth; x++)
+        {
+            int r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < 2; dy++)
+            {
+                for (int dx = 0; dx < 2; dx++)
+                {
+                    int sx = x * 2 + dx < width ? x * 2 + dx : width - 1;
+                    int sy = y * 2 + dy < height ? y * 2 + dy : height - 1;
+                    const unsigned char* p = pixels + ((size_t)sy * width + sx) * 3;
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            }
+
+            size_t i = (size_t)y * chromaWidth + x;
+            cb[i] = ClampByte(128 + ((-11059 * r - 21709 * g + 32768 * b + 131072) >> 18));
+            cr[i] = ClampByte(128 + ((32768 * r - 27439 * g - 5329 * b + 131072) >> 18));
+        }
+    }
+}
+
+ImageFormat ImageFormatFromPath(const char* filePath)
+{
+    const char* extension = strrchr(filePath, '.');
+    if (extension == NULL) return ImageFormatRaw;
+    if (strcmp(extension, ".png") == 0) return ImageFormatPNG;
+    if (strcmp(extension, ".ppm") == 0) return ImageFormatPPM;
+    if (strcmp(extension, ".y4m") == 0) return ImageFormatY4M;
+    return ImageFormatRaw;
+}
+
+void ImageEncode(ImageBuffer* buffer, ImageFormat format, const unsigned char* pixels, int width,
+    int height)
+{
+    pthread_once(&tablesOnce, InitializeTables);
+
+    if (format == ImageFormatPNG)
+    {
+        EncodePNG(buffer, pixels, width, height);
+    }
+    else if (format == ImageFormatY4M)
+    {
+        EncodeY4MFrame(buffer, pixels, width, height);
+    }
+    else
+    {
+        if (format == ImageFormatPPM)
+        {
+            char header[32];
+            int length = snprintf(header, sizeof(header), "P6 %d %d 255\n", width, height);
+            Append(buffer, header, length);
+        }
+
+        Append(buffer, pixels, (size_t)width * height * 3);
+    }
+}
+
+void ImageY4MHeader(ImageBuffer* buffer, int width, int height, double frameRate)
+{
+    char header[96];
+    int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%ld:1000 Ip A1:1 C420jpeg\n",
+        width, height, (long)(frameRate * 1000.0 + 0.5));
+    Append(buffer, header, length);
+}
+
+bool ImageWrite(const char* filePath, const unsigned char* pixels, int width, int height)
+{
+    ImageBuffer buffer = { 0 };
+    ImageFormat format = ImageFormatFromPath(filePath);
+    if (format == ImageFormatY4M) ImageY4MHeader(&buffer, width, height, 1.0);
+    ImageEncode(&buffer, format, pixels, width, height);
+
+    FILE* file = fopen(filePath, "wb");
+    if (file == NULL)
+    {
+        printf("Error opening file at path: %s\n", filePath);
+        ImageBufferFree(&buffer);
+        return false;
+    }
+
+    bool written = fwrite(buffer.data, 1, buffer.length, file) == buffer.length;
+    fclose(file);
+    ImageBufferFree(&buffer);
+    return written;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum ImageFormat
+{
+    ImageFormatRaw, // The bare RGB pixels
+    ImageFormatPPM,
+    ImageFormatPNG,
+    ImageFormatY4M, // One YUV 4:2:0 frame of a YUV4MPEG2 stream, see ImageY4MHeader
+} ImageFormat;
+
+// Growable byte buffer that images are encoded into
+typedef struct ImageBuffer
+{
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+} ImageBuffer;
+
+void ImageBufferFree(ImageBuffer* buffer);
+
+// Selects the format from the extension of the path: .png, .ppm, .y4m, otherwise raw
+ImageFormat ImageFormatFromPath(const char* filePath);
+
+// Appends 8 bit RGB pixels, stored top row first, encoded in the format
+void ImageEncode(ImageBuffer* buffer, ImageFormat format, const unsigned char* pixels, int width,
+    int height);
+
+// Appends the header that precedes the frames of a YUV4MPEG2 stream
+void ImageY4MHeader(ImageBuffer* buffer, int width, int height, double frameRate);
+
+// Writes 8 bit RGB pixels, stored top row first, to an image file in the format of its extension
+// Returns false if the file cannot be written
+bool ImageWrite(const char* filePath, const unsigned char* pixels, int width, int height);
\ No newline at end of file
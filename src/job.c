@@ -0,0 +1,204 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "job.h"
+#include "parallel.h"
+#include "timer.h"
+
+#define MaxJobThreads 64
+#define JobDequeCapacity 256
+
+typedef struct Job
+{
+    JobFunction function;
+    void* data;
+    JobCounter* counter;
+} Job;
+
+// A ring of jobs; the owner pushes and pops at the bottom and thieves take from the top
+// The lock is held only to move a job in or out
+typedef struct JobDeque
+{
+    Job jobs[JobDequeCapacity];
+    unsigned int top;
+    unsigned int bottom;
+    pthread_mutex_t mutex;
+} JobDeque;
+
+static JobDeque deques[MaxJobThreads];
+static atomic_uint dequeCount;
+static _Thread_local JobDeque* ownDeque;
+
+static pthread_t workers[MaxJobThreads];
+static unsigned int workerCount;
+static pthread_once_t startOnce = PTHREAD_ONCE_INIT;
+
+// Idle workers sleep until a job is pushed
+static atomic_uint queuedCount;
+static pthread_mutex_t sleepMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobQueued = PTHREAD_COND_INITIALIZER;
+static bool stopping;
+
+static void StartWorkers();
+
+// Gives the calling thread a deque the first time it runs jobs; returns NULL if every
+// deque is taken, in which case its jobs run immediately
+static JobDeque* AcquireDeque()
+{
+    if (ownDeque) return ownDeque;
+    pthread_once(&startOnce, StartWorkers);
+
+    unsigned int index = atomic_load(&dequeCount);
+    do
+    {
+        if (index == MaxJobThreads) return NULL;
+    } while (!atomic_compare_exchange_weak(&dequeCount, &index, index + 1));
+
+    ownDeque = &deques[index];
+    return ownDeque;
+}
+
+static bool PushJob(JobDeque* deque, const Job* job)
+{
+    pthread_mutex_lock(&deque->mutex);
+    bool pushed = deque->bottom - deque->top < JobDequeCapacity;
+    if (pushed) deque->jobs[deque->bottom++ % JobDequeCapacity] = *job;
+    pthread_mutex_unlock(&deque->mutex);
+    return pushed;
+}
+
+// Takes the newest job from the calling thread's deque
+static bool PopJob(JobDeque* deque, Job* job)
+{
+    pthread_mutex_lock(&deque->mutex);
+    bool popped = deque->bottom != deque->top;
+    if (popped) *job = deque->jobs[--deque->bottom % JobDequeCapacity];
+    pthread_mutex_unlock(&deque->mutex);
+    return popped;
+}
+
+// Takes the oldest job of another thread, which is likely the largest
+static bool StealJob(JobDeque* deque, Job* job)
+{
+    if (pthread_mutex_trylock(&deque->mutex) != 0) return false;
+    bool stolen = deque->bottom != deque->top;
+    if (stolen) *job = deque->jobs[deque->top++ % JobDequeCapacity];
+    pthread_mutex_unlock(&deque->mutex);
+    return stolen;
+}
+
+static bool FindJob(JobDeque* deque, Job* job)
+{
+    if (deque && PopJob(deque, job)) return true;
+
+    // Victims are visited starting after the calling thread so that thieves spread out
+    unsigned int count = atomic_load(&dequeCount);
+    unsigned int first = deque ? (unsigned int)(deque - deques) + 1 : 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        JobDeque* victim = &deques[(first + i) % count];
+        if (victim != deque && StealJob(victim, job)) return true;
+    }
+
+    return false;
+}
+
+static void ExecuteJob(const Job* job)
+{
+    atomic_fetch_sub(&queuedCount, 1);
+    job->function(job->data);
+    atomic_fetch_sub_explicit(&job->counter->remaining, 1, memory_order_release);
+}
+
+static void* RunWorker(void* arg)
+{
+    TimerTraceNameThread("Job worker");
+    JobDeque* deque = AcquireDeque();
+
+    while (true)
+    {
+        Job job;
+        if (FindJob(deque, &job))
+        {
+            ExecuteJob(&job);
+            continue;
+        }
+
+        pthread_mutex_lock(&sleepMutex);
+        while (atomic_load(&queuedCount) == 0 && !stopping) pthread_cond_wait(&jobQueued, &sleepMutex);
+        bool stop = stopping;
+        pthread_mutex_unlock(&sleepMutex);
+
+        if (stop) return NULL;
+    }
+}
+
+// Every deque's lock is created before any thread can take or steal from it
+static void StartWorkers()
+{
+    for (int i = 0; i < MaxJobThreads; i++)
+    {
+        pthread_mutex_init(&deques[i].mutex, NULL);
+    }
+
+    unsigned int count = ParallelThreadCount() - 1;
+    if (count > MaxJobThreads / 2) count = MaxJobThreads / 2;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (pthread_create(&workers[workerCount], NULL, RunWorker, NULL) != 0)
+        {
+            printf("Failed to start job worker %u!\n", i);
+            break;
+        }
+        workerCount++;
+    }
+}
+
+void JobRun(JobFunction function, void* data, JobCounter* counter)
+{
+    JobDeque* deque = AcquireDeque();
+    Job job = { function, data, counter };
+    atomic_fetch_add_explicit(&counter->remaining, 1, memory_order_relaxed);
+    atomic_fetch_add(&queuedCount, 1);
+
+    if (workerCount == 0 || !deque || !PushJob(deque, &job))
+    {
+        ExecuteJob(&job);
+        return;
+    }
+
+    // Taking the lock orders the wakeup after a worker's check of queuedCount
+    pthread_mutex_lock(&sleepMutex);
+    pthread_cond_signal(&jobQueued);
+    pthread_mutex_unlock(&sleepMutex);
+}
+
+void JobWait(JobCounter* counter)
+{
+    JobDeque* deque = AcquireDeque();
+
+    while (atomic_load_explicit(&counter->remaining, memory_order_acquire) > 0)
+    {
+        // The jobs left are running on other threads when none can be found
+        Job job;
+        if (FindJob(deque, &job)) ExecuteJob(&job);
+        else sched_yield();
+    }
+}
+
+void JobSystemShutdown()
+{
+    pthread_mutex_lock(&sleepMutex);
+    stopping = true;
+    pthread_cond_broadcast(&jobQueued);
+    pthread_mutex_unlock(&sleepMutex);
+
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    workerCount = 0;
+}
\ No newline at end of file
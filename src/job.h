@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdatomic.h>
+
+typedef void (*JobFunction)(void* data);
+
+// Counts the unfinished jobs of a fork/join group; zero it before the first JobRun
+typedef struct JobCounter
+{
+    atomic_uint remaining;
+} JobCounter;
+
+// Runs jobs on a pool of ParallelThreadCount() - 1 workers started by the first JobRun
+// Every thread that runs jobs has its own deque: it pushes and pops jobs at one end while
+// idle threads steal from the other, so nested jobs stay on the thread that made them
+void JobRun(JobFunction function, void* data, JobCounter* counter);
+
+// Runs or steals other jobs until every job counted by `counter` has finished
+void JobWait(JobCounter* counter);
+
+// Stops and joins the workers; jobs must not be running
+void JobSystemShutdown();
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+// Layouts shared between C and GLSL are described once as a list of fields, from which
+// the C struct, its GLSL declaration and compile time std430 checks are generated
+//
+// A struct's fields are listed as X(S, type, name) with GLSL type names:
+//     #define CircleLayout(X, S) X(S, vec2, position) X(S, float, radius)
+//     LayoutStruct(Circle, CircleLayout)
+//     LayoutCheck(Circle, CircleLayout)
+// and LayoutGLSL(Circle, CircleLayout) is the matching GLSL struct as a string literal
+//
+// A vertex format lists its attributes as X(S, location, type, name) with float types;
+// LayoutAttributesGLSL declares them as shader inputs and LayoutVertexAttributes
+// configures the bound vertex array to read them
+
+#include <stddef.h>
+#include <cglm\cglm.h>
+#include "renderer.h"
+
+// C type of each supported GLSL type
+#define LayoutCType_float float
+#define LayoutCType_int int
+#define LayoutCType_uint unsigned int
+#define LayoutCType_vec2 vec2
+#define LayoutCType_vec3 vec3
+#define LayoutCType_vec4 vec4
+#define LayoutCType_mat4 mat4
+
+// Base alignment of each type in std430, also the std140 alignment outside of arrays
+#define LayoutAlign_float 4
+#define LayoutAlign_int 4
+#define LayoutAlign_uint 4
+#define LayoutAlign_vec2 8
+#define LayoutAlign_vec3 16
+#define LayoutAlign_vec4 16
+#define LayoutAlign_mat4 16
+
+#define LayoutCField(S, type, name) LayoutCType_##type name;
+#define LayoutGLSLField(S, type, name) "    " #type " " #name ";\n"
+
+// C places a field at the first offset aligned for its C type, which never exceeds its
+// std430 alignment, so the offsets agree exactly when the C offset is std430 aligned
+// The size check does the same for the padding at the end of the struct
+#define LayoutCheckField(S, type, name) \
+    _Static_assert(offsetof(S, name) % LayoutAlign_##type == 0, \
+        #S "." #name " is not at its std430 offset; add padding before it"); \
+    _Static_assert(sizeof(S) % LayoutAlign_##type == 0, \
+        "sizeof(" #S ") is not a multiple of its std430 alignment; add padding at the end");
+
+#define LayoutStruct(Name, Fields) typedef struct Name { Fields(LayoutCField, Name) } Name;
+#define LayoutGLSL(Name, Fields) "struct " #Name "\n{\n" Fields(LayoutGLSLField, Name) "};\n\n"
+#define LayoutCheck(Name, Fields) Fields(LayoutCheckField, Name)
+
+#define LayoutCAttribute(S, location, type, name) LayoutCType_##type name;
+#define LayoutGLSLAttribute(S, location, type, name) \
+    "layout(location = " #location ") in " #type " " #name ";\n"
+#define LayoutPointerAttribute(S, location, type, name) \
+    VertexAttribPointerFloats(location, sizeof(LayoutCType_##type) / sizeof(float), sizeof(S), offsetof(S, name));
+
+#define LayoutVertex(Name, Attributes) typedef struct Name { Attributes(LayoutCAttribute, Name) } Name;
+#define LayoutAttributesGLSL(Name, Attributes) Attributes(LayoutGLSLAttribute, Name)
+#define LayoutVertexAttributes(Name, Attributes) Attributes(LayoutPointerAttribute, Name)
\ No newline at end of file
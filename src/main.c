@@ -16,6 +16,10 @@
 #include "input.h"
 #include "color.h"
 #include "physics.h"
+#include "timer.h"
+#include "benchmark.h"
+#include "simulation.h"
+#include "parallel.h"
 
 static const int WIDTH = 1280;
 static const int HEIGHT = 720;
@@ -25,14 +29,16 @@ static void ProcessInput(GLFWwindow* window, float deltaTime);
 static float zoom = 12.0f;
 static int paused = 0;
 
-// TODO: is this uniformly distributed?
+static uint32_t randomState = 1;
+
+// A linear congruential generator rather than rand, so that benchmark scenes are the
+// same with every C runtime
 static inline float RandomRange(float min, float max)
 {
-    return rand() * (max - min) / RAND_MAX + min;
+    randomState = randomState * 1664525u + 1013904223u;
+    return (randomState >> 8) * (max - min) / 16777216.0f + min;
 }
 
-GLFWwindow* SimInitWindow(int width, int height, const char* title, int isFullscreen);
-
 GLFWwindow* window;
 
 double startTime;
@@ -41,6 +47,45 @@ double currentSimTime;
 
 Line2D* bounds;
 Surface s;
+Mesh mesh;
+bool hasMesh;
+Circle* circles;
+
+// Circles fall and bounce inside this box on the plane z = 0, above the surface
+#define BoxLeft -10.0f
+#define BoxRight 10.0f
+#define BoxBottom 2.5f
+#define BoxTop 10.0f
+#define Gravity 4.0f
+
+// Circles stepped by one thread at a time
+#define MinCirclesPerThread 4096
+
+typedef struct CircleBody
+{
+    vec2 position;
+    vec2 velocity;
+    float radius;
+} CircleBody;
+
+// The state advanced by Step on the simulation thread
+typedef struct World
+{
+    double time;
+    unsigned int circleCount;
+    CircleBody circles[];
+} World;
+
+typedef struct StepContext
+{
+    const World* previous;
+    World* next;
+    float timeStep;
+} StepContext;
+
+// z = 10 * x * y / exp(x^2 + y^2), sampled from -3 to 3 around the origin
+// and evaluated on the GPU, so animating it costs nothing on the CPU
+static const char* surfaceFunction = "return 10.0 * x * y * exp(-(x * x + y * y)) * cos(t);";
 
 GLFWwindow* Initialize()
 {
@@ -48,6 +93,7 @@ GLFWwindow* Initialize()
     if (window == NULL)
     {
         printf("Error!\n"); // TODO: handle this better
+        return NULL;
     }
 
     printf("OpenGL version: %s\n", glGetString(GL_VERSION));
@@ -59,6 +105,7 @@ GLFWwindow* Initialize()
     printf("Max uniform buffer size: %d\n", maxUBOSize);
 
     CameraUsePerspective(45.0f, ((float)WIDTH) / HEIGHT, 0.1f, 50.0f);
+    SurfaceSetPrimitiveMode(SurfacePrimitiveStrips);
     //CameraUseOrthographic(((float)WIDTH) / HEIGHT, 10.0f);
 
     vec3 origin = { 0, 0, 0 };
@@ -66,27 +113,60 @@ GLFWwindow* Initialize()
     PolygonLine(origin, (vec3) { 0, 1, 0 }, COLOR_GREEN);
     PolygonLine(origin, (vec3) { 0, 0, 1 }, COLOR_BLUE);
 
-    int n = 21;
-    float scale = 0.3f;
-    float* surfaceData = malloc(n * n * 4 * sizeof(float));
-    for (int c = 0; c < n; c++)
+    const SimOptions* options = SimGetOptions();
+    PolygonSetCullMode(options->cullMode);
+
+    // The surface covers the same area and domain at any size
+    int n = options->surfaceSize;
+    SurfaceDomain surfaceDomain = { { -3.0f, -3.0f }, 6.0f / (n - 1) };
+    SurfaceInitializeAnalytic(&s, (vec3) { -10.0f, 0, -10.0f }, 20.0f / (n - 1), n, &surfaceDomain,
+        surfaceFunction, -2.0f, 2.0f);
+    SurfaceSetLighting(&s, true);
+
+    // Circles are scattered through the box with random velocities; their positions
+    // are set from the world every frame
+    size_t worldSize = sizeof(World) + options->circleCount * sizeof(CircleBody);
+    World* world = malloc(worldSize);
+    world->time = 0.0;
+    world->circleCount = options->circleCount;
+
+    circles = PolygonCircles(options->circleCount);
+    for (unsigned int i = 0; i < options->circleCount; i++)
     {
-        for (int r = 0; r < n; r++)
-        {
-            float x = r - n / 2;
-            float y = c - n / 2;
-            x *= scale;
-            y *= scale;
-            float height = 10 * x * y / (expf(x * x + y * y));
-            int vertIndex = r + n * c;
-            surfaceData[vertIndex * 4 + 0] = height;
-            glm_vec3_copy(COLOR_FLORALWHITE, &surfaceData[vertIndex * 4 + 1]);
-        }
+        CircleBody* body = &world->circles[i];
+        body->radius = RandomRange(0.05f, 0.3f);
+        body->position[0] = RandomRange(BoxLeft + body->radius, BoxRight - body->radius);
+        body->position[1] = RandomRange(BoxBottom + body->radius, BoxTop - body->radius);
+        body->velocity[0] = RandomRange(-2.0f, 2.0f);
+        body->velocity[1] = RandomRange(-2.0f, 2.0f);
+
+        circles[i].radius = body->radius;
+        circles[i].color[0] = RandomRange(0.2f, 1.0f);
+        circles[i].color[1] = RandomRange(0.2f, 1.0f);
+        circles[i].color[2] = RandomRange(0.2f, 1.0f);
     }
 
-    SurfaceInitialize(&s, (vec3) { -n / 2, 0, -n / 2 }, 1.0f, surfaceData, n);
+    SimInitializeWorld(world, worldSize);
+    free(world);
+
+    // The mesh is scaled to 8 units across and stands on the surface's highest point
+    if (options->meshPath)
+    {
+        hasMesh = MeshLoad(&mesh, options->meshPath, (vec3) { 0.8f, 0.75f, 0.7f });
+        if (!hasMesh) return NULL;
+
+        vec3 size, center;
+        glm_vec3_sub(mesh.boundsMax, mesh.boundsMin, size);
+        glm_vec3_center(mesh.boundsMin, mesh.boundsMax, center);
+        mesh.scale = 8.0f / fmaxf(size[0], fmaxf(size[1], size[2]));
+
+        vec3 placement = { 0.0f, 2.0f, 0.0f };
+        center[1] = mesh.boundsMin[1];
+        glm_vec3_scale(center, -mesh.scale, mesh.origin);
+        glm_vec3_add(mesh.origin, placement, mesh.origin);
+    }
 
-    startTime = glfwGetTime();
+    startTime = SimGetTime();
     lastFPSUpdate = startTime;
 
     //GLCall(glPolygonMode(GL_FRONT_AND_BACK, GL_LINE));
@@ -100,18 +180,39 @@ float camPitch = 0;
 
 void Update(float deltaTime)
 {
-    double currentFrameTime = glfwGetTime();
+    double currentFrameTime = SimGetTime();
     currentSimTime = currentFrameTime - startTime;
 
     if (lastFPSUpdate + 0.5 < currentFrameTime)
     {
-        char fpsText[30];
-        snprintf(fpsText, 30, "Viewer | Render: %3.2f ms", deltaTime * 1000.0);
+        RendererStateStats stats;
+        RendererGetFrameStats(&stats);
+        unsigned int binds = stats.programBinds + stats.vertexArrayBinds + stats.bufferBinds;
+        unsigned int elided = stats.programBindsElided + stats.vertexArrayBindsElided +
+            stats.bufferBindsElided;
+
+        unsigned int visibleCount, totalCount;
+        PolygonGetCullStats(&visibleCount, &totalCount);
+
+        TimerStats gpu = { 0 };
+        TimerGetZoneStats("Frame", &gpu, NULL);
+
+        char fpsText[128];
+        snprintf(fpsText, 128, "Viewer | Render: %3.2f ms | GPU: %3.2f ms (p99 %3.2f) | Binds elided: %u/%u | Visible: %u/%u",
+            deltaTime * 1000.0, gpu.avg, gpu.p99, elided, binds, visibleCount, totalCount);
 
         glfwSetWindowTitle(window, fpsText);
         lastFPSUpdate += 0.5;
     }
 
+    // Benchmarks replace input with a scripted camera path so that every run renders
+    // the same frames
+    if (SimGetOptions()->benchmark)
+    {
+        BenchmarkMoveCamera(currentSimTime, 25.0f);
+        return;
+    }
+
     ProcessInput(window, deltaTime);
 
     vec2 scrollDelta;
@@ -136,9 +237,68 @@ void Update(float deltaTime)
     CameraViewToWorldPoint(mouseCoords, worldMouseCoords);
 }
 
+static void StepCircles(unsigned int start, unsigned int end, void* context)
+{
+    StepContext* step = context;
+    float dt = step->timeStep;
+
+    for (unsigned int i = start; i < end; i++)
+    {
+        CircleBody body = step->previous->circles[i];
+        body.velocity[1] -= Gravity * dt;
+        glm_vec2_muladds(body.velocity, dt, body.position);
+
+        // Only circles moving into a wall bounce, so none stick outside the box
+        if ((body.position[0] - body.radius < BoxLeft && body.velocity[0] < 0.0f) ||
+            (body.position[0] + body.radius > BoxRight && body.velocity[0] > 0.0f))
+        {
+            glm_vec2_reflect_axis(body.velocity, 1, body.velocity);
+        }
+
+        if ((body.position[1] - body.radius < BoxBottom && body.velocity[1] < 0.0f) ||
+            (body.position[1] + body.radius > BoxTop && body.velocity[1] > 0.0f))
+        {
+            glm_vec2_reflect_axis(body.velocity, 0, body.velocity);
+        }
+
+        step->next->circles[i] = body;
+    }
+}
+
+// Runs on the simulation thread; computes the world at `time` from the world one
+// step earlier
+void Step(const void* previous, void* next, double time, double timeStep)
+{
+    StepContext context = { previous, next, (float)timeStep };
+    context.next->time = time;
+    context.next->circleCount = context.previous->circleCount;
+
+    ParallelFor(context.previous->circleCount, MinCirclesPerThread, StepCircles, &context);
+}
+
 void Render(float deltaTime)
 {
+    const World* previous;
+    const World* current;
+    float alpha;
+    SimGetWorld((const void**)&previous, (const void**)&current, &alpha);
+
+    // Frames fall between steps, so they show the world interpolated between the two
+    // newest states
+    if (current)
+    {
+        for (unsigned int i = 0; i < current->circleCount; i++)
+        {
+            glm_vec2_lerp((float*)previous->circles[i].position, (float*)current->circles[i].position,
+                alpha, circles[i].position);
+        }
+        if (current->circleCount > 0) PolygonMarkDirty();
+
+        SurfaceSetTime(&s, (float)(previous->time + (current->time - previous->time) * alpha));
+    }
+
     SurfaceDraw(&s);
+    if (hasMesh) MeshDraw(&mesh);
 }
 
 static void ProcessInput(GLFWwindow* window, float deltaTime)
@@ -158,6 +318,11 @@ static void ProcessInput(GLFWwindow* window, float deltaTime)
         paused = !paused;
     }
 
+    if (InputKeyPressed(window, GLFW_KEY_F12))
+    {
+        TimerWriteTrace("trace.json");
+    }
+
     glm_vec3_scale(movement, deltaTime * speed, movement);
 
     CameraTranslateRelative(movement);
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include "mesh.h"
+#include "model_parser.h"
+#include "shader.h"
+#include "timer.h"
+#include "debug.h"
+
+const char* MeshVertShaderPath = "shaders/Mesh.vert";
+const char* MeshFragShaderPath = "shaders/Mesh.frag";
+
+static unsigned int meshShaderId;
+static vec3 lightDirection;
+
+void MeshesInitialize(UniformBuffer* vpMatrixBuffer, unsigned int shaderId)
+{
+    meshShaderId = shaderId;
+    ShaderBindUniformBuffer(meshShaderId, "Matrices", vpMatrixBuffer);
+
+    // Lit from the same direction as surfaces by default
+    glm_vec3_copy((vec3) { 0.3f, 1.0f, 0.5f }, lightDirection);
+    glm_vec3_normalize(lightDirection);
+}
+
+bool MeshLoad(Mesh* mesh, const char* filePath, vec3 color)
+{
+    VertexArrayInitialize(&mesh->vertexArray);
+    VertexArrayBind(&mesh->vertexArray);
+
+    if (ModelToBuffers(filePath, &mesh->vertexArray) != 0)
+    {
+        VertexArrayUnbind();
+        VertexArrayDelete(&mesh->vertexArray);
+        return false;
+    }
+
+    VertexArrayUnbind();
+
+    glm_vec3_broadcast(FLT_MAX, mesh->boundsMin);
+    glm_vec3_broadcast(-FLT_MAX, mesh->boundsMax);
+
+    vec3* vertices = mesh->vertexArray.vertexBufferData;
+    size_t vertexCount = mesh->vertexArray.vertexBufferSize / sizeof(vec3);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        glm_vec3_minv(mesh->boundsMin, vertices[i], mesh->boundsMin);
+        glm_vec3_maxv(mesh->boundsMax, vertices[i], mesh->boundsMax);
+    }
+
+    glm_vec3_zero(mesh->origin);
+    mesh->scale = 1.0f;
+    glm_vec3_copy(color, mesh->color);
+
+    return true;
+}
+
+void MeshDraw(Mesh* mesh)
+{
+    TimerBeginZone("Mesh");
+
+    ShaderUse(meshShaderId);
+    ShaderSetVec3(meshShaderId, "origin", mesh->origin);
+    ShaderSetFloat(meshShaderId, "scale", mesh->scale);
+    ShaderSetVec3(meshShaderId, "color", mesh->color);
+    ShaderSetVec3(meshShaderId, "lightDirection", lightDirection);
+
+    VertexArrayBind(&mesh->vertexArray);
+    GLCall(glDrawElements(GL_TRIANGLES, mesh->vertexArray.indexBufferCount, GL_UNSIGNED_INT, NULL));
+
+    TimerEndZone();
+}
+
+void MeshDelete(Mesh* mesh)
+{
+    VertexArrayDelete(&mesh->vertexArray);
+    VertexBufferDelete(&mesh->vertexArray);
+    IndexBufferDelete(&mesh->vertexArray);
+    free(mesh->vertexArray.vertexBufferData);
+    free(mesh->vertexArray.indexBufferData);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <cglm\cglm.h>
+#include "renderer.h"
+
+// A triangle mesh loaded from an .obj file and shaded with flat face normals
+typedef struct Mesh
+{
+    VertexArray vertexArray;
+    vec3 boundsMin; // Bounding box of the vertices in model space
+    vec3 boundsMax;
+    vec3 origin; // Position in world space of the model space origin
+    float scale;
+    vec3 color;
+} Mesh;
+
+// The shaders of the mesh program, which PolygonInitialize creates with its own
+extern const char* MeshVertShaderPath;
+extern const char* MeshFragShaderPath;
+
+// Initializes mesh rendering with the program built from MeshVertShaderPath and
+// MeshFragShaderPath; called by PolygonInitialize
+void MeshesInitialize(UniformBuffer* vpMatrixBuffer, unsigned int shaderId);
+
+// Loads the vertices and triangles of an .obj file; returns false if it cannot be read
+// The mesh is placed at the world origin with a scale of one
+bool MeshLoad(Mesh* mesh, const char* filePath, vec3 color);
+
+void MeshDraw(Mesh* mesh);
+void MeshDelete(Mesh* mesh);
\ No newline at end of file
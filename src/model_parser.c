@@ -5,6 +5,21 @@
 #include "model_parser.h"
 #include "renderer.h"
 #include "debug.h"
+#include "parallel.h"
+#include "arena.h"
+
+// Files are parsed in parallel in chunks of about this many bytes, split after newlines
+#define ModelChunkSize (64 * 1024)
+
+typedef struct ModelChunk
+{
+    char* start;
+    int length;
+    unsigned int vertexCount;
+    unsigned int faceCount;
+    float* vertices; // Where the chunk's vertices and faces are written
+    unsigned int* faces;
+} ModelChunk;
 
 // Returns the length of the file
 int ReadModel(const char* filePath, char* buffer)
@@ -28,26 +43,120 @@ int ReadModel(const char* filePath, char* buffer)
     return actualLength;
 }
 
+// Returns the size of the file in bytes, or -1 if it cannot be opened
+static long ModelFileSize(const char* filePath)
+{
+    FILE* file = fopen(filePath, "r");
+    if (file == NULL) return -1;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// Splits the file into chunks that end after a newline or at the end of the file
+static unsigned int SplitModel(char* data, int length, ModelChunk* chunks)
+{
+    unsigned int chunkCount = 0;
+    int start = 0;
+    while (start < length)
+    {
+        int end = start + ModelChunkSize < length ? start + ModelChunkSize : length;
+        while (end < length && data[end - 1] != '\n') end++;
+
+        chunks[chunkCount].start = data + start;
+        chunks[chunkCount].length = end - start;
+        chunkCount++;
+        start = end;
+    }
+
+    return chunkCount;
+}
+
+// Counts the vertices and faces of chunks where ParseModel finds them
+static void CountChunks(unsigned int start, unsigned int end, void* context)
+{
+    ModelChunk* chunks = context;
+    for (unsigned int c = start; c < end; c++)
+    {
+        ModelChunk* chunk = &chunks[c];
+        chunk->vertexCount = 0;
+        chunk->faceCount = 0;
+
+        for (int i = 0; i < chunk->length - 1; i++)
+        {
+            if (chunk->start[i + 1] != ' ') continue;
+            if (chunk->start[i] == 'v') chunk->vertexCount++;
+            if (chunk->start[i] == 'f') chunk->faceCount++;
+        }
+    }
+}
+
+static void ParseChunks(unsigned int start, unsigned int end, void* context)
+{
+    ModelChunk* chunks = context;
+    for (unsigned int c = start; c < end; c++)
+    {
+        ModelChunk* chunk = &chunks[c];
+        ParseModel(chunk->start, chunk->length, chunk->vertices, chunk->vertexCount, chunk->faces,
+            chunk->faceCount);
+    }
+}
+
+// Loads a model into the vertex array, which must be bound; returns -1 on failure
 int ModelToBuffers(const char* filePath, VertexArray* vertexArray) {
-    char* buffer = malloc(8 * 1024); // allocate 8K
+    long fileSize = ModelFileSize(filePath);
+    if (fileSize == -1)
+    {
+        printf("Error opening file at path: %s\n", filePath);
+        return -1;
+    }
+
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* buffer = ArenaAlloc(scratch, fileSize + 1);
 
     int modelLength = ReadModel(filePath, buffer);
-    if (modelLength == -1) return -1;
+    if (modelLength == -1)
+    {
+        ArenaRestore(scratch, mark);
+        return -1;
+    }
 
-    int modelCounts[2];
-    GetModelBufferCounts(buffer, modelLength, modelCounts);
-    printf("V: %d; F: %d\n", modelCounts[0], modelCounts[1]);
+    ModelChunk* chunks = ArenaAlloc(scratch, (modelLength / ModelChunkSize + 1) * sizeof(ModelChunk));
+    unsigned int chunkCount = SplitModel(buffer, modelLength, chunks);
+    ParallelFor(chunkCount, 1, CountChunks, chunks);
+
+    unsigned int vertexCount = 0;
+    unsigned int faceCount = 0;
+    for (unsigned int c = 0; c < chunkCount; c++)
+    {
+        vertexCount += chunks[c].vertexCount;
+        faceCount += chunks[c].faceCount;
+    }
+    printf("V: %u; F: %u\n", vertexCount, faceCount);
 
-    unsigned int vertexCount = modelCounts[0];
-    unsigned int faceCount = modelCounts[1];
     float* vertices = malloc(vertexCount * sizeof(vec3));
     unsigned int* faces = malloc(faceCount * 3 * sizeof(unsigned int));
 
-    ParseModel(buffer, modelLength, vertices, vertexCount, faces, faceCount);
-    free(buffer);
+    // Each chunk writes after the vertices and faces of the chunks before it
+    float* chunkVertices = vertices;
+    unsigned int* chunkFaces = faces;
+    for (unsigned int c = 0; c < chunkCount; c++)
+    {
+        chunks[c].vertices = chunkVertices;
+        chunks[c].faces = chunkFaces;
+        chunkVertices += chunks[c].vertexCount * 3;
+        chunkFaces += chunks[c].faceCount * 3;
+    }
+
+    ParallelFor(chunkCount, 1, ParseChunks, chunks);
+    ArenaRestore(scratch, mark);
 
     VertexBufferInitialize(vertexArray, vertices, vertexCount * sizeof(vec3), GL_STATIC_DRAW);
-    VertexAttribPointerFloats(0, 3, 12);
+    VertexAttribPointerFloats(0, 3, 12, 0);
     IndexBufferInitialize(vertexArray, faces, faceCount * 3, GL_STATIC_DRAW);
     
     return 0;
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "renderer.h"
+
+int ModelToBuffers(const char* filePath, VertexArray* vertexArray);
 int ReadModel(const char* filePath, char* buffer);
 void GetModelBufferCounts(char* data, int length, int counts[2]);
 void ParseModel(char* data, int length, float* vertices, unsigned int vertexCount, 
@@ -0,0 +1,91 @@
+#include <pthread.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "parallel.h"
+#include "job.h"
+#include "timer.h"
+
+#define MaxThreadCount 64
+
+typedef struct ParallelRange
+{
+    unsigned int start;
+    unsigned int end;
+    ParallelForFunction function;
+    void* context;
+} ParallelRange;
+
+static unsigned int threadCount = 0;
+static pthread_once_t threadCountOnce = PTHREAD_ONCE_INIT;
+
+static void RunRange(void* data)
+{
+    ParallelRange* range = data;
+    TimerTraceBegin("Parallel range");
+    range->function(range->start, range->end, range->context);
+    TimerTraceEnd();
+}
+
+static void CountThreads()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    threadCount = info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    threadCount = count > 0 ? count : 1;
+#endif
+
+    if (threadCount > MaxThreadCount) threadCount = MaxThreadCount;
+}
+
+// Returns the number of hardware threads available
+// Safe to call from any thread, including job workers
+unsigned int ParallelThreadCount()
+{
+    pthread_once(&threadCountOnce, CountThreads);
+    return threadCount;
+}
+
+// Splits [0, count) into contiguous ranges of at least `minRange` items and
+// processes them as jobs, one of which runs on the calling thread
+// Returns once every range has been processed
+void ParallelFor(unsigned int count, unsigned int minRange, ParallelForFunction function,
+    void* context)
+{
+    if (count == 0) return;
+    if (minRange == 0) minRange = 1;
+
+    unsigned int rangeCount = count / minRange;
+    if (rangeCount > ParallelThreadCount()) rangeCount = ParallelThreadCount();
+
+    if (rangeCount <= 1)
+    {
+        function(0, count, context);
+        return;
+    }
+
+    ParallelRange ranges[MaxThreadCount];
+    for (unsigned int i = 0; i < rangeCount; i++)
+    {
+        ranges[i].start = (unsigned long long)count * i / rangeCount;
+        ranges[i].end = (unsigned long long)count * (i + 1) / rangeCount;
+        ranges[i].function = function;
+        ranges[i].context = context;
+    }
+
+    // The calling thread takes the first range, then helps with the rest
+    JobCounter counter = { 0 };
+    for (unsigned int i = 1; i < rangeCount; i++)
+    {
+        JobRun(RunRange, &ranges[i], &counter);
+    }
+
+    RunRange(&ranges[0]);
+    JobWait(&counter);
+}
\ No newline at end of file
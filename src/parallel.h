@@ -0,0 +1,8 @@
+#pragma once
+
+// Processes the items in [start, end)
+typedef void (*ParallelForFunction)(unsigned int start, unsigned int end, void* context);
+
+unsigned int ParallelThreadCount();
+void ParallelFor(unsigned int count, unsigned int minRange, ParallelForFunction function,
+    void* context);
\ No newline at end of file
@@ -1,9 +1,13 @@
 #include <string.h>
+#include <stddef.h>
 #include <cglm\cglm.h>
 #include "polygon.h"
 #include "shader.h"
 #include "renderer.h"
 #include "debug.h"
+#include "cull.h"
+#include "timer.h"
+#include "arena.h"
 
 // The maximum depth used for the circle generation algorithm
 // A higher level yields a better circle approximation
@@ -12,40 +16,157 @@
 #define CircleVertexCount (3 * (1 << MaxCircleGenLevel))
 #define CircleTriangles (3 * ((1 << MaxCircleGenLevel) - 1) + 1)
 static const int VerticesPerLine = 2;
-static const int VerticesPerRect = 4;
+static const int VerticesPerRect = 6;
+static const int VerticesPerPoint = 1;
 
 static const char* BasicFragShaderPath = "shaders/BasicFrag.frag";
-static const char* RectVertShaderPath = "shaders/InstancedRect.vert";
-static const char* CircleVertShaderPath = "shaders/InstancedCircle.vert";
-static const char* Line2DVertShaderPath = "shaders/InstancedLine2D.vert";
-static const char* LineVertShaderPath = "shaders/InstancedLine.vert";
-static const char* PointVertShaderPath = "shaders/InstancedPoint.vert";
-static const char* SurfaceVertShaderPath = "shaders/Surface.vert";
+static const char* PrimitiveVertShaderPath = "shaders/Primitive.vert";
+static const char* CullPrimitivesShaderPath = "shaders/CullPrimitives.comp";
+
+// Must match local_size_x in CullPrimitives.comp
+#define CullWorkGroupSize 64
+
+// CullPrimitives.comp keeps the visible count of each of its work groups after the draw commands
+#define CullMaxWorkGroups (PolygonMaxCount / CullWorkGroupSize)
+
+// CullPrimitives.comp copies instances as whole vec4s and reads their bounds at fixed offsets
+_Static_assert(sizeof(Circle) % 16 == 0 && sizeof(Rect) % 16 == 0 && sizeof(Line2D) % 16 == 0
+    && sizeof(Line) % 16 == 0 && sizeof(Point) % 16 == 0, "Primitives must be a whole number of vec4s");
+_Static_assert(offsetof(Circle, position) == 16 && offsetof(Circle, radius) == 24
+    && offsetof(Rect, position) == 16 && offsetof(Rect, width) == 24 && offsetof(Rect, height) == 28
+    && offsetof(Line2D, a) == 16 && offsetof(Line2D, b) == 24
+    && offsetof(Line, a) == 16 && offsetof(Line, b) == 32
+    && offsetof(Point, position) == 0, "Update Bounds in CullPrimitives.comp to match the primitive layouts");
+
+// Vertex of the base geometry that every primitive instance transforms
+#define PrimitiveVertexLayout(X, S) \
+    X(S, 0, vec2, position)
+
+LayoutVertex(PrimitiveVertex, PrimitiveVertexLayout)
+
+// Generated declarations included by Primitive.vert
+static const char* PrimitivesInclude =
+    LayoutAttributesGLSL(PrimitiveVertex, PrimitiveVertexLayout)
+    "\n"
+    LayoutGLSL(Circle, CircleLayout)
+    LayoutGLSL(Rect, RectLayout)
+    LayoutGLSL(Line2D, Line2DLayout)
+    LayoutGLSL(Line, LineLayout)
+    LayoutGLSL(Point, PointLayout);
+
+#define MaxCircleCount PolygonMaxCount
+#define MaxRectCount PolygonMaxCount
+#define MaxLine2DCount PolygonMaxCount
+#define MaxLineCount PolygonMaxCount
+#define MaxPointCount PolygonMaxCount
+
+// Instance tags hold the primitive type above the index within its array
+#define PrimitiveTagTypeShift 24
+
+// Order matches the type ids in Primitive.vert and the draw commands
+typedef enum PrimitiveType
+{
+    PrimitiveCircle,
+    PrimitiveRect,
+    PrimitiveLine2D,
+    PrimitiveLine,
+    PrimitivePoint,
+    PrimitiveTypeCount
+} PrimitiveType;
+
+// The per-type uniforms of CullPrimitives.comp are set through the uniform cache
+_Static_assert(PrimitiveTypeCount * sizeof(unsigned int) <= ShaderMaxUniformValueSize,
+    "The per-type uniforms of CullPrimitives.comp must fit in the uniform cache");
+
+// CPU copy of the primitive storage buffer; every primitive type lives in one buffer
+// and each array is bound to its own storage block in Primitive.vert
+typedef struct PrimitiveStorage
+{
+    Circle circles[MaxCircleCount];
+    Rect rects[MaxRectCount];
+    Line2D line2Ds[MaxLine2DCount];
+    Line lines[MaxLineCount];
+    Point points[MaxPointCount];
+} PrimitiveStorage;
+
+static const unsigned int MaxPrimitiveCounts[PrimitiveTypeCount] =
+{
+    MaxCircleCount, MaxRectCount, MaxLine2DCount, MaxLineCount, MaxPointCount
+};
+
+static const unsigned int PrimitiveSizes[PrimitiveTypeCount] =
+{
+    sizeof(Circle), sizeof(Rect), sizeof(Line2D), sizeof(Line), sizeof(Point)
+};
 
-static VertexArray UnitCircleVertexArray;
-static VertexArray UnitSquareVertexArray;
-static VertexArray PointVertexArray;
+static const char* PrimitiveBlockNames[PrimitiveTypeCount] =
+{
+    "Circles", "Rects", "Line2Ds", "Lines", "Points"
+};
 
-static bool IsInitialized = false;
+static const unsigned int PrimitiveOffsets[PrimitiveTypeCount] =
+{
+    offsetof(PrimitiveStorage, circles),
+    offsetof(PrimitiveStorage, rects),
+    offsetof(PrimitiveStorage, line2Ds),
+    offsetof(PrimitiveStorage, lines),
+    offsetof(PrimitiveStorage, points),
+};
+
+// Draw commands sharing a primitive mode are submitted together
+// Triangles: circles and rects, lines: 2d and 3d lines, points: points
+typedef struct PrimitiveBatch
+{
+    const char* name; // Profiler zone of the batch's draw
+    GLenum mode;
+    PrimitiveType firstType;
+    unsigned int typeCount;
+} PrimitiveBatch;
+
+static const PrimitiveBatch PrimitiveBatches[] =
+{
+    { "Polygon triangles", GL_TRIANGLES, PrimitiveCircle, 2 },
+    { "Polygon lines", GL_LINES, PrimitiveLine2D, 2 },
+    { "Polygon points", GL_POINTS, PrimitivePoint, 1 },
+};
 
-// TODO: make primitive instance struct
+static VertexArray PrimitiveVertexArray;
+static unsigned int primitiveTagBufferId;
 
-static const int MaxCircleCount = 2048;
-static const int MaxRectCount = 2048;
-static const int MaxLine2DCount = 2048;
-static const int MaxLineCount = 1024;
-static const int MaxPointCount = 2048;
+static bool IsInitialized = false;
 
+static PrimitiveStorage* primitives;
 static Circle* circles;
 static Rect* rects;
 static Line2D* line2Ds;
 static Line* lines;
 static Point* points;
 
-static UniformBuffer circlesBuffer;
-static UniformBuffer rectsBuffer;
-static UniformBuffer line2DsBuffer;
-static UniformBuffer linesBuffer;
+static StorageBuffer primitivesBuffer;
+
+// Visible instances, compacted per type, when culling on the CPU
+static PrimitiveStorage* culledPrimitives;
+static PolygonCullMode cullMode = PolygonCullNone;
+static Frustum frustum;
+static unsigned int lastVisibleCount;
+static unsigned int lastTotalCount;
+
+// Upper bound of the instances drawn of each type this frame
+static unsigned int drawnCounts[PrimitiveTypeCount];
+
+// All instances, resident on the GPU, when culling with a compute shader
+static StorageBuffer sourcePrimitivesBuffer;
+static unsigned int sourcePrimitiveCounts[PrimitiveTypeCount];
+static bool sourcePrimitivesDirty;
+static unsigned int cullShaderId;
+static DrawArraysIndirectCommand drawCommands[PrimitiveTypeCount];
+static IndirectBuffer drawCommandsBuffer;
+
+// The draw commands written by the compute shader are copied here and read back once
+// the copy completes, so the visible count reported lags the frame by one or more
+static unsigned int visibleCountsBufferId;
+static GLsync visibleCountsFence;
+static unsigned int gpuVisibleCount;
 
 static unsigned int numCircles;
 static unsigned int numRects;
@@ -56,14 +177,11 @@ static unsigned int numPoints;
 static mat4 vpMatrix;
 static UniformBuffer vpMatrixUB;
 
-static unsigned int circleShaderId;
-static unsigned int rectShaderId;
-static unsigned int line2DShaderId;
-static unsigned int lineShaderId;
-static unsigned int pointShaderId;
-static unsigned int surfaceShaderId;
+static unsigned int primitiveShaderId;
 
-static void InitializeUnitCircle()
+// Writes the triangles of the unit circle into `vertData`
+// Returns the number of vertices written
+static int GenerateUnitCircle(PrimitiveVertex* vertData)
 {
     vec2 vertLookup[CircleVertexCount];
 
@@ -78,7 +196,6 @@ static void InitializeUnitCircle()
     // printf("CircleVertexCount: %d\n", CircleVertexCount);
     // printf("CircleTriangles: %d\n", CircleTriangles);
 
-    vec2* vertData = malloc(sizeof(vec2) * CircleTriangles * 3);
     int globalIndex = 0;
 
     // render n = 4 levels
@@ -94,111 +211,146 @@ static void InitializeUnitCircle()
         {
             int vIndex = i * stride * 2; // base vertex index in lookup
 
-            glm_vec2_copy(vertLookup[vIndex], vertData[globalIndex]);
-            glm_vec2_copy(vertLookup[vIndex + stride], vertData[globalIndex + 1]);
-            glm_vec2_copy(vertLookup[(vIndex + 2 * stride) % CircleVertexCount], vertData[globalIndex + 2]);
+            glm_vec2_copy(vertLookup[vIndex], vertData[globalIndex].position);
+            glm_vec2_copy(vertLookup[vIndex + stride], vertData[globalIndex + 1].position);
+            glm_vec2_copy(vertLookup[(vIndex + 2 * stride) % CircleVertexCount], vertData[globalIndex + 2].position);
 
             // printf("%d, %d, %d\n", vertexIndex, vertexIndex + stride, (vertexIndex + 2 * stride) % CircleVertexCount);
             globalIndex += 3;
         }
     }
 
-    VertexArrayInitialize(&UnitCircleVertexArray);
-    VertexArrayBind(&UnitCircleVertexArray);
-
-    VertexBufferInitialize(&UnitCircleVertexArray, vertData,
-        sizeof(vec2) * CircleTriangles * 3, GL_STATIC_DRAW);
+    return globalIndex;
+}
 
-    VertexAttribPointerFloats(0, 2, 8);
+// Writes a unit square (side length one) centered at the origin as two triangles
+// Returns the number of vertices written
+static int GenerateUnitSquare(PrimitiveVertex* vertData)
+{
+    glm_vec2_copy((vec2) { 0.5f, 0.5f }, vertData[0].position);
+    glm_vec2_copy((vec2) { -0.5f, 0.5f }, vertData[1].position);
+    glm_vec2_copy((vec2) { -0.5f, -0.5f }, vertData[2].position);
+    glm_vec2_copy((vec2) { 0.5f, 0.5f }, vertData[3].position);
+    glm_vec2_copy((vec2) { -0.5f, -0.5f }, vertData[4].position);
+    glm_vec2_copy((vec2) { 0.5f, -0.5f }, vertData[5].position);
+    return VerticesPerRect;
+}
 
-    VertexArrayUnbind();
-    free(vertData);
+// Lines interpolate between their endpoints with x in [0, 1]
+// Returns the number of vertices written
+static int GenerateUnitLine(PrimitiveVertex* vertData)
+{
+    glm_vec2_copy((vec2) { 0.0f, 0.0f }, vertData[0].position);
+    glm_vec2_copy((vec2) { 1.0f, 0.0f }, vertData[1].position);
+    return VerticesPerLine;
 }
 
-// Initializes a unit square (side length one) centered at the origin
-static void InitializeUnitSquare()
+// Builds the base geometry of every primitive type into one vertex buffer
+// and sets up the draw command of each type to reference its range
+static void InitializePrimitiveGeometry()
 {
-    vec2 UnitSquareVertices[4];
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
 
-    glm_vec2_copy((vec2) { 0.5f, 0.5f }, UnitSquareVertices[0]);
-    glm_vec2_copy((vec2) { -0.5f, 0.5f }, UnitSquareVertices[1]);
-    glm_vec2_copy((vec2) { -0.5f, -0.5f }, UnitSquareVertices[2]);
-    glm_vec2_copy((vec2) { 0.5f, -0.5f }, UnitSquareVertices[3]);
+    int vertexCount = CircleTriangles * 3 + VerticesPerRect + VerticesPerLine + VerticesPerPoint;
+    PrimitiveVertex* vertData = ArenaAlloc(scratch, sizeof(PrimitiveVertex) * vertexCount);
 
-    VertexArrayInitialize(&UnitSquareVertexArray);
-    VertexArrayBind(&UnitSquareVertexArray);
+    int first = 0;
+    int count;
 
-    VertexBufferInitialize(&UnitSquareVertexArray, UnitSquareVertices,
-        sizeof(UnitSquareVertices), GL_STATIC_DRAW);
+    count = GenerateUnitCircle(vertData + first);
+    drawCommands[PrimitiveCircle] = (DrawArraysIndirectCommand) { count, 0, first, 0 };
+    first += count;
 
-    VertexAttribPointerFloats(0, 2, 8);
+    count = GenerateUnitSquare(vertData + first);
+    drawCommands[PrimitiveRect] = (DrawArraysIndirectCommand) { count, 0, first, 0 };
+    first += count;
 
-    VertexArrayUnbind();
-}
+    count = GenerateUnitLine(vertData + first);
+    drawCommands[PrimitiveLine2D] = (DrawArraysIndirectCommand) { count, 0, first, 0 };
+    drawCommands[PrimitiveLine] = (DrawArraysIndirectCommand) { count, 0, first, 0 };
+    first += count;
 
-static void InitializePointVertexArray()
-{
-    VertexArrayInitialize(&PointVertexArray);
-    VertexArrayBind(&PointVertexArray);
+    glm_vec2_zero(vertData[first].position);
+    drawCommands[PrimitivePoint] = (DrawArraysIndirectCommand) { VerticesPerPoint, 0, first, 0 };
+
+    // Each type's instances start at its own range of the tag buffer
+    unsigned int tagCount = 0;
+    for (int type = 0; type < PrimitiveTypeCount; type++)
+    {
+        drawCommands[type].baseInstance = tagCount;
+        tagCount += MaxPrimitiveCounts[type];
+    }
+
+    unsigned int* tags = ArenaAlloc(scratch, sizeof(unsigned int) * tagCount);
+    for (int type = 0; type < PrimitiveTypeCount; type++)
+    {
+        unsigned int* typeTags = tags + drawCommands[type].baseInstance;
+        for (unsigned int i = 0; i < MaxPrimitiveCounts[type]; i++)
+        {
+            typeTags[i] = (type << PrimitiveTagTypeShift) | i;
+        }
+    }
+
+    VertexArrayInitialize(&PrimitiveVertexArray);
+    VertexArrayBind(&PrimitiveVertexArray);
+
+    VertexBufferInitialize(&PrimitiveVertexArray, vertData, sizeof(PrimitiveVertex) * vertexCount, GL_STATIC_DRAW);
+    LayoutVertexAttributes(PrimitiveVertex, PrimitiveVertexLayout);
 
-    VertexBufferInitialize(&PointVertexArray, points, sizeof(Point) * MaxPointCount, GL_DYNAMIC_DRAW);
-    VertexAttribPointerFloats(0, 3, 32); // vec3 position
-    VertexAttribPointerFloats(1, 1, 32); // float pointSize
-    VertexAttribPointerFloats(2, 3, 32); // vec3 color
+    GLCall(glGenBuffers(1, &primitiveTagBufferId));
+    RendererBindBuffer(GL_ARRAY_BUFFER, primitiveTagBufferId);
+    GLCall(glBufferData(GL_ARRAY_BUFFER, sizeof(unsigned int) * tagCount, tags, GL_STATIC_DRAW));
+    VertexAttribPointerUInts(1, 1, 4);
+    VertexAttribDivisor(1, 1);
 
     VertexArrayUnbind();
+    ArenaRestore(scratch, mark);
+
+    IndirectBufferInitialize(&drawCommandsBuffer, drawCommands, PrimitiveTypeCount, GL_DYNAMIC_DRAW);
 }
 
 void PolygonInitialize()
 {
-    InitializeUnitCircle();
-    InitializeUnitSquare();
-
     // Initialize primitive buffers
-    int circlesSize = sizeof(Circle) * MaxCircleCount;
-    int rectsSize = sizeof(Rect) * MaxRectCount;
-    int line2DsSize = sizeof(Line2D) * MaxLine2DCount;
-    int linesSize = sizeof(Line) * MaxLineCount;
-    int pointsSize = sizeof(Point) * MaxPointCount;
-
-    circles = malloc(circlesSize);
-    rects = malloc(rectsSize);
-    line2Ds = malloc(line2DsSize);
-    lines = malloc(linesSize);
-    points = malloc(pointsSize);
-
-    memset(circles, 0, circlesSize);
-    memset(rects, 0, rectsSize);
-    memset(line2Ds, 0, line2DsSize);
-    memset(lines, 0, linesSize);
-    memset(points, 0, pointsSize);
-
-    InitializePointVertexArray(); // requires that `points` points to valid memory
-
-    UniformBufferInitialize(&circlesBuffer, circles, circlesSize, GL_DYNAMIC_DRAW);
-    UniformBufferInitialize(&rectsBuffer, rects, rectsSize, GL_DYNAMIC_DRAW);
-    UniformBufferInitialize(&line2DsBuffer, line2Ds, line2DsSize, GL_DYNAMIC_DRAW);
-    UniformBufferInitialize(&linesBuffer, lines, linesSize, GL_DYNAMIC_DRAW);
-
-    rectShaderId = ShaderCreate(RectVertShaderPath, BasicFragShaderPath);
-    circleShaderId = ShaderCreate(CircleVertShaderPath, BasicFragShaderPath);
-    line2DShaderId = ShaderCreate(Line2DVertShaderPath, BasicFragShaderPath);
-    lineShaderId = ShaderCreate(LineVertShaderPath, BasicFragShaderPath);
-    pointShaderId = ShaderCreate(PointVertShaderPath, BasicFragShaderPath);
-    surfaceShaderId = ShaderCreate(SurfaceVertShaderPath, BasicFragShaderPath);
+    primitives = malloc(sizeof(PrimitiveStorage));
+    memset(primitives, 0, sizeof(PrimitiveStorage));
+
+    circles = primitives->circles;
+    rects = primitives->rects;
+    line2Ds = primitives->line2Ds;
+    lines = primitives->lines;
+    points = primitives->points;
+
+    InitializePrimitiveGeometry();
+
+    StorageBufferInitialize(&primitivesBuffer, primitives, sizeof(PrimitiveStorage), GL_DYNAMIC_DRAW);
+
+    ShaderDefineInclude("Primitives.glsl", PrimitivesInclude);
+
+    // The programs compile together, in parallel where the driver supports it
+    ShaderProgramRequest programs[] = {
+        { PrimitiveVertShaderPath, BasicFragShaderPath },
+        { SurfaceVertShaderPath, BasicFragShaderPath },
+        { MeshVertShaderPath, MeshFragShaderPath },
+    };
+    ShaderCreateBatch(programs, 3);
+    primitiveShaderId = programs[0].programId;
 
     UniformBufferInitialize(&vpMatrixUB, vpMatrix, sizeof(mat4), GL_DYNAMIC_DRAW);
-    ShaderBindUniformBuffer(rectShaderId, "Matrices", &vpMatrixUB);
-    ShaderBindUniformBuffer(circleShaderId, "Matrices", &vpMatrixUB);
-    ShaderBindUniformBuffer(line2DShaderId, "Matrices", &vpMatrixUB);
-    ShaderBindUniformBuffer(lineShaderId, "Matrices", &vpMatrixUB);
-    ShaderBindUniformBuffer(pointShaderId, "Matrices", &vpMatrixUB);
-    ShaderBindUniformBuffer(surfaceShaderId, "Matrices", &vpMatrixUB);
-
-    ShaderBindUniformBuffer(circleShaderId, "Circles", &circlesBuffer);
-    ShaderBindUniformBuffer(rectShaderId, "Rectangles", &rectsBuffer);
-    ShaderBindUniformBuffer(line2DShaderId, "Lines", &line2DsBuffer);
-    ShaderBindUniformBuffer(lineShaderId, "Lines", &linesBuffer);
+    ShaderBindUniformBuffer(primitiveShaderId, "Matrices", &vpMatrixUB);
+
+    for (int type = 0; type < PrimitiveTypeCount; type++)
+    {
+        unsigned int bindingPoint = StorageBufferBindRange(&primitivesBuffer, PrimitiveOffsets[type],
+            PrimitiveSizes[type] * MaxPrimitiveCounts[type]);
+        ShaderBindStorageBlock(primitiveShaderId, PrimitiveBlockNames[type], bindingPoint);
+    }
+
+    GLCall(glEnable(GL_PROGRAM_POINT_SIZE));
+
+    SurfacesInitialize(&vpMatrixUB, programs[1].programId);
+    MeshesInitialize(&vpMatrixUB, programs[2].programId);
 
     IsInitialized = true;
 }
@@ -274,150 +426,313 @@ Line* PolygonLines(unsigned int count)
     return ls;
 }
 
-void SurfaceInitialize(Surface* surface, vec3 origin, float scale, float* data, uint32_t n)
+static void CircleBounds(const void* instances, unsigned int count,
+    float* x, float* y, float* z, float* radius)
 {
-    glm_vec3_copy(origin, surface->origin);
-    surface->scale = scale;
-    surface->n = n;
+    const Circle* cs = instances;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        x[i] = cs[i].position[0];
+        y[i] = cs[i].position[1];
+        z[i] = 0.0f;
+        radius[i] = cs[i].radius;
+    }
+}
+
+static void RectBounds(const void* instances, unsigned int count,
+    float* x, float* y, float* z, float* radius)
+{
+    const Rect* rs = instances;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        x[i] = rs[i].position[0];
+        y[i] = rs[i].position[1];
+        z[i] = 0.0f;
+        radius[i] = 0.5f * sqrtf(rs[i].width * rs[i].width + rs[i].height * rs[i].height);
+    }
+}
 
-    int dataSize = sizeof(vec4) * n * n;
-    surface->vertices = data;
+static void Line2DBounds(const void* instances, unsigned int count,
+    float* x, float* y, float* z, float* radius)
+{
+    const Line2D* ls = instances;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float dx = ls[i].b[0] - ls[i].a[0];
+        float dy = ls[i].b[1] - ls[i].a[1];
+        x[i] = 0.5f * (ls[i].a[0] + ls[i].b[0]);
+        y[i] = 0.5f * (ls[i].a[1] + ls[i].b[1]);
+        z[i] = 0.0f;
+        radius[i] = 0.5f * sqrtf(dx * dx + dy * dy);
+    }
+}
+
+static void LineBounds(const void* instances, unsigned int count,
+    float* x, float* y, float* z, float* radius)
+{
+    const Line* ls = instances;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float dx = ls[i].b[0] - ls[i].a[0];
+        float dy = ls[i].b[1] - ls[i].a[1];
+        float dz = ls[i].b[2] - ls[i].a[2];
+        x[i] = 0.5f * (ls[i].a[0] + ls[i].b[0]);
+        y[i] = 0.5f * (ls[i].a[1] + ls[i].b[1]);
+        z[i] = 0.5f * (ls[i].a[2] + ls[i].b[2]);
+        radius[i] = 0.5f * sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+}
 
-    VertexArray* va = &surface->vertexArray;
+static void PointBounds(const void* instances, unsigned int count,
+    float* x, float* y, float* z, float* radius)
+{
+    const Point* ps = instances;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        x[i] = ps[i].position[0];
+        y[i] = ps[i].position[1];
+        z[i] = ps[i].position[2];
+        radius[i] = 0.0f;
+    }
+}
 
-    VertexArrayInitialize(va);
-    VertexArrayBind(va);
+static const CullBoundsFunction PrimitiveBounds[PrimitiveTypeCount] =
+{
+    CircleBounds, RectBounds, Line2DBounds, LineBounds, PointBounds
+};
 
-    VertexBufferInitialize(va, data, dataSize, GL_DYNAMIC_DRAW);
-    VertexAttribPointerFloats(0, 1, 16); // height
-    VertexAttribPointerFloats(1, 3, 16); // color rgb
+// Culls the resident instances with a compute shader, which writes the visible
+// ones to the primitive buffer in their original order and counts them in the draw commands
+// Instances are only uploaded when their counts change or they are marked dirty
+static void CullPrimitivesOnGPU(unsigned int counts[PrimitiveTypeCount])
+{
+    unsigned int maxCount = 0;
 
-    // An n x n grid contains (n - 1) x (n - 1) squares.
-    // So we need 2 * (n - 1) * (n - 1) triangles,
-    // which have 3 * 2 * (n - 1) * (n - 1) vertices.
-    int numVertices = 3 * 2 * (n - 1) * (n - 1);
-    unsigned int* indexData = malloc(sizeof(unsigned int) * numVertices);
+    for (int type = 0; type < PrimitiveTypeCount; type++)
+    {
+        if (counts[type] != sourcePrimitiveCounts[type]) sourcePrimitivesDirty = true;
+        if (counts[type] > maxCount) maxCount = counts[type];
 
-    /* Triangulation
-    (x,y)
-     a---b
-     |  /|
-     | / |
-     |/  |
-     c---d (x + 1, y + 1)
-    */
+        drawCommands[type].instanceCount = 0;
+        drawnCounts[type] = counts[type];
+    }
 
-    int vertIndex = 0;
-    for (int x = 0; x < n - 1; x++)
+    if (sourcePrimitivesDirty)
     {
-        for (int y = 0; y < n - 1; y++)
+        for (int type = 0; type < PrimitiveTypeCount; type++)
         {
-            int a = x + y * n;
-            int b = a + 1;
-            int c = a + n;
-            int d = c + 1;
-            indexData[vertIndex + 0] = a; // top left tri
-            indexData[vertIndex + 1] = b;
-            indexData[vertIndex + 2] = c;
-
-            indexData[vertIndex + 3] = b; // bottom right tri
-            indexData[vertIndex + 4] = d;
-            indexData[vertIndex + 5] = c;
-            vertIndex += 6;
+            StorageBufferUpdateRange(&sourcePrimitivesBuffer, PrimitiveOffsets[type],
+                PrimitiveSizes[type] * counts[type]);
+            sourcePrimitiveCounts[type] = counts[type];
         }
+
+        sourcePrimitivesDirty = false;
     }
 
-    IndexBufferInitialize(va, indexData, numVertices, GL_STATIC_DRAW);
+    IndirectBufferUpdate(&drawCommandsBuffer);
 
-    free(indexData); // TODO: hopefully we don't access this data again
+    // The first pass counts the visible instances of each work group and the second
+    // writes each one after those of earlier work groups
+    unsigned int groupCount = (maxCount + CullWorkGroupSize - 1) / CullWorkGroupSize;
+    ShaderUse(cullShaderId);
+    ShaderSetUInts(cullShaderId, "counts", counts, PrimitiveTypeCount);
+    for (unsigned int pass = 0; pass < 2; pass++)
+    {
+        ShaderSetUInts(cullShaderId, "pass", &pass, 1);
+        GLCall(glDispatchCompute(groupCount, PrimitiveTypeCount, 1));
+        GLCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+    }
 
-    VertexArrayUnbind();
+    GLCall(glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT));
 }
 
-void SurfaceDraw(Surface* surface)
+// Reads the visible counts of an earlier frame if their copy has completed, without waiting,
+// then copies this frame's counts unless an earlier copy is still in flight
+static void ReadBackVisibleCount()
 {
-    VertexArray* va = &surface->vertexArray;
-    VertexBufferUpdate(va);
-    ShaderUse(surfaceShaderId);
+    if (visibleCountsFence)
+    {
+        GLCall(GLenum status = glClientWaitSync(visibleCountsFence, 0, 0));
+        if (status == GL_TIMEOUT_EXPIRED) return;
+
+        GLCall(glDeleteSync(visibleCountsFence));
+        visibleCountsFence = NULL;
 
-    GLCall(glUniform3f(glGetUniformLocation(surfaceShaderId, "origin"), surface->origin[0], surface->origin[1], surface->origin[2]));
-    GLCall(glUniform1f(glGetUniformLocation(surfaceShaderId, "scale"), surface->scale));
-    GLCall(glUniform1i(glGetUniformLocation(surfaceShaderId, "n"), surface->n));
+        DrawArraysIndirectCommand commands[PrimitiveTypeCount];
+        RendererBindBuffer(GL_COPY_WRITE_BUFFER, visibleCountsBufferId);
+        GLCall(glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(commands), commands));
 
-    VertexArrayBind(va);
-    GLCall(glDrawElements(GL_TRIANGLES, va->indexBufferCount, GL_UNSIGNED_INT, 0))
+        gpuVisibleCount = 0;
+        for (int type = 0; type < PrimitiveTypeCount; type++)
+        {
+            gpuVisibleCount += commands[type].instanceCount;
+        }
+    }
+
+    RendererBindBuffer(GL_COPY_READ_BUFFER, drawCommandsBuffer.bufferId);
+    RendererBindBuffer(GL_COPY_WRITE_BUFFER, visibleCountsBufferId);
+    GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(drawCommands)));
+    GLCall(visibleCountsFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
 }
 
-static void DrawCircles()
+// Creates the compute shader and resident instance buffer used by PolygonCullGPU
+static void InitializeGPUCulling()
 {
-    UniformBufferUpdateRange(&circlesBuffer, 0, sizeof(Circle) * numCircles);
-    ShaderUse(circleShaderId);
-    VertexArrayBind(&UnitCircleVertexArray);
-    GLCall(glDrawArraysInstanced(GL_TRIANGLES, 0, CircleTriangles * 3, numCircles));
+    StorageBufferInitialize(&sourcePrimitivesBuffer, primitives, sizeof(PrimitiveStorage), GL_DYNAMIC_DRAW);
+
+    cullShaderId = ShaderCreateCompute(CullPrimitivesShaderPath);
+    ShaderBindUniformBuffer(cullShaderId, "Matrices", &vpMatrixUB);
+    ShaderBindStorageBuffer(cullShaderId, "Source", &sourcePrimitivesBuffer);
+    ShaderBindStorageBuffer(cullShaderId, "Destination", &primitivesBuffer);
+    // Room for the visible count of each work group after the draw commands
+    RendererBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandsBuffer.bufferId);
+    GLCall(glBufferData(GL_DRAW_INDIRECT_BUFFER,
+        sizeof(drawCommands) + sizeof(unsigned int) * PrimitiveTypeCount * CullMaxWorkGroups,
+        NULL, GL_DYNAMIC_DRAW));
+    IndirectBufferUpdate(&drawCommandsBuffer);
+    ShaderBindStorageBlock(cullShaderId, "DrawCommands", IndirectBufferBindStorage(&drawCommandsBuffer));
+
+    GLCall(glGenBuffers(1, &visibleCountsBufferId));
+    RendererBindBuffer(GL_COPY_WRITE_BUFFER, visibleCountsBufferId);
+    GLCall(glBufferData(GL_COPY_WRITE_BUFFER, sizeof(drawCommands), NULL, GL_STREAM_READ));
+
+    unsigned int offsets[PrimitiveTypeCount];
+    unsigned int strides[PrimitiveTypeCount];
+    for (int type = 0; type < PrimitiveTypeCount; type++)
+    {
+        offsets[type] = PrimitiveOffsets[type] / sizeof(vec4);
+        strides[type] = PrimitiveSizes[type] / sizeof(vec4);
+    }
+
+    // Set through the shader module so that they survive the program being reloaded
+    ShaderSetUInts(cullShaderId, "offsets", offsets, PrimitiveTypeCount);
+    ShaderSetUInts(cullShaderId, "strides", strides, PrimitiveTypeCount);
 }
 
-static void DrawRects()
+// Uploads the instances in use and the instance count of each primitive type
+// When culling, only the visible instances are compacted and uploaded
+static void UploadPrimitives()
 {
-    UniformBufferUpdateRange(&rectsBuffer, 0, sizeof(Rect) * numRects);
-    ShaderUse(rectShaderId);
-    VertexArrayBind(&UnitSquareVertexArray);
-    GLCall(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, VerticesPerRect, numRects));
+    unsigned int counts[PrimitiveTypeCount] = { numCircles, numRects, numLine2Ds, numLines, numPoints };
+
+    lastTotalCount = 0;
+    lastVisibleCount = 0;
+
+    for (int type = 0; type < PrimitiveTypeCount; type++)
+    {
+        lastTotalCount += counts[type];
+    }
+
+    if (cullMode == PolygonCullGPU)
+    {
+        CullPrimitivesOnGPU(counts);
+        ReadBackVisibleCount();
+        lastVisibleCount = gpuVisibleCount;
+        return;
+    }
+
+    for (int type = 0; type < PrimitiveTypeCount; type++)
+    {
+        unsigned int count = counts[type];
+
+        if (cullMode == PolygonCullCPU)
+        {
+            unsigned int offset = PrimitiveOffsets[type];
+            count = CullInstances(&frustum, PrimitiveBounds[type], (char*)primitives + offset,
+                count, PrimitiveSizes[type], (char*)culledPrimitives + offset);
+        }
+
+        lastVisibleCount += count;
+        StorageBufferUpdateRange(&primitivesBuffer, PrimitiveOffsets[type],
+            PrimitiveSizes[type] * count);
+        drawCommands[type].instanceCount = count;
+        drawnCounts[type] = count;
+    }
+
+    IndirectBufferUpdate(&drawCommandsBuffer);
 }
 
-static void DrawLine2Ds()
+// Selects whether instances outside the view are removed before they are drawn
+void PolygonSetCullMode(PolygonCullMode mode)
 {
-    UniformBufferUpdateRange(&line2DsBuffer, 0, sizeof(Line2D) * numLine2Ds);
-    ShaderUse(line2DShaderId);
-    VertexArrayBind(&UnitSquareVertexArray); // why do we bind unit square for lines??
-    GLCall(glDrawArraysInstanced(GL_LINES, 0, VerticesPerLine, numLine2Ds));
+    // GPU culling binds the resident instances and the draw commands as storage buffers
+    if (mode == PolygonCullGPU && cullShaderId == 0 && RendererFreeStorageBindingPoints() < 2)
+    {
+        printf("Not enough shader storage binding points to cull on the GPU; culling on the CPU\n");
+        mode = PolygonCullCPU;
+    }
+
+    if (mode == PolygonCullCPU && culledPrimitives == NULL)
+    {
+        culledPrimitives = malloc(sizeof(PrimitiveStorage));
+    }
+
+    if (mode == PolygonCullGPU && cullShaderId == 0)
+    {
+        InitializeGPUCulling();
+    }
+
+    cullMode = mode;
+    sourcePrimitivesDirty = true;
+
+    primitivesBuffer.data = mode == PolygonCullCPU ? culledPrimitives : primitives;
 }
 
-static void DrawLines()
+// Instances modified through returned pointers must be marked dirty to be
+// uploaded again when culling on the GPU; other modes upload every frame
+void PolygonMarkDirty()
 {
-    UniformBufferUpdateRange(&linesBuffer, 0, sizeof(Line) * numLines);
-    ShaderUse(lineShaderId);
-    VertexArrayBind(&UnitSquareVertexArray); // why do we bind unit square for lines??
-    GLCall(glDrawArraysInstanced(GL_LINES, 0, VerticesPerLine, numLines));
+    sourcePrimitivesDirty = true;
 }
 
-static void DrawPoints()
+// Gets the number of instances drawn and allocated in the last frame
+// When culling on the GPU the drawn count is read back late and is of an earlier frame
+void PolygonGetCullStats(unsigned int* visibleCount, unsigned int* totalCount)
 {
-    VertexBufferUpdateRange(&PointVertexArray, 0, sizeof(Point) * numPoints);
-    ShaderUse(pointShaderId);
-    VertexArrayBind(&PointVertexArray);
-    GLCall(glDrawArrays(GL_POINT, 0, numPoints)); // TODO: `glEnable(GL_VERTEX_PROGRAM_POINT_SIZE)` somewhere
+    *visibleCount = lastVisibleCount;
+    *totalCount = lastTotalCount;
 }
 
+// Draws every primitive type with one shader and one multi-draw per primitive mode
 void PolygonRenderPolygons()
 {
-    if (numRects > 0)
-    {
-        DrawRects();
-    }
+    if (numCircles + numRects + numLine2Ds + numLines + numPoints == 0) return;
 
-    if (numCircles > 0)
-    {
-        DrawCircles();
-    }
+    TimerBeginZone("Polygons");
 
-    if (numLine2Ds > 0)
-    {
-        DrawLine2Ds();
-    }
+    TimerBeginZone("Polygon upload");
+    UploadPrimitives();
+    TimerEndZone();
 
-    if (numLines > 0)
-    {
-        DrawLines();
-    }
+    ShaderUse(primitiveShaderId);
+    VertexArrayBind(&PrimitiveVertexArray);
+    IndirectBufferBind(&drawCommandsBuffer);
 
-    if (numPoints > 0)
+    for (int i = 0; i < sizeof(PrimitiveBatches) / sizeof(PrimitiveBatch); i++)
     {
-        DrawPoints();
+        const PrimitiveBatch* batch = &PrimitiveBatches[i];
+
+        unsigned int instanceCount = 0;
+        for (int type = batch->firstType; type < batch->firstType + batch->typeCount; type++)
+        {
+            instanceCount += drawnCounts[type];
+        }
+
+        if (instanceCount == 0) continue;
+
+        TimerBeginZone(batch->name);
+        const void* offset = (const void*)(sizeof(DrawArraysIndirectCommand) * batch->firstType);
+        GLCall(glMultiDrawArraysIndirect(batch->mode, offset, batch->typeCount, 0));
+        TimerEndZone();
     }
+
+    TimerEndZone();
 }
 
 void PolygonUpdateViewPerspectiveMatrix(mat4 m)
 {
     glm_mat4_copy(m, vpMatrix);
+    FrustumFromMatrix(vpMatrix, &frustum);
+    SurfacesUpdateViewPerspectiveMatrix(vpMatrix);
     UniformBufferUpdate(&vpMatrixUB);
 }
\ No newline at end of file
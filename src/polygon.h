@@ -4,64 +4,68 @@
 
 #include <cglm\cglm.h>
 #include "renderer.h"
-
-typedef struct Circle
-{
-    vec3 color;
-    float padding;
-    vec2 position;
-    float radius;
-    float padding2;
-} Circle;
-
-typedef struct Rect
-{
-    vec3 color;
-    float padding;
-    vec2 position;
-    float width;
-    float height;
-} Rect;
-
-typedef struct Line2D
-{
-    vec3 color;
-    float padding;
-    vec2 a;
-    vec2 b;
-} Line2D;
-
-typedef struct Line
-{
-    vec3 color;
-    float padding;
-    vec3 a;
-    float thickness; // TODO: implement thickness
-    vec3 b;
-    float padding2;
-} Line;
-
-typedef struct Point
+#include "surface.h"
+#include "mesh.h"
+#include "layout.h"
+
+// Primitives are read from std430 storage blocks declared in Primitive.vert; their GLSL
+// structs are generated from these layouts, see PolygonInitialize
+#define CircleLayout(X, S) \
+    X(S, vec3, color) \
+    X(S, float, padding) \
+    X(S, vec2, position) \
+    X(S, float, radius) \
+    X(S, float, padding2)
+
+#define RectLayout(X, S) \
+    X(S, vec3, color) \
+    X(S, float, padding) \
+    X(S, vec2, position) \
+    X(S, float, width) \
+    X(S, float, height)
+
+#define Line2DLayout(X, S) \
+    X(S, vec3, color) \
+    X(S, float, padding) \
+    X(S, vec2, a) \
+    X(S, vec2, b)
+
+// TODO: implement thickness
+#define LineLayout(X, S) \
+    X(S, vec3, color) \
+    X(S, float, padding) \
+    X(S, vec3, a) \
+    X(S, float, thickness) \
+    X(S, vec3, b) \
+    X(S, float, padding2)
+
+#define PointLayout(X, S) \
+    X(S, vec3, position) \
+    X(S, float, pointSize) \
+    X(S, vec3, color) \
+    X(S, float, padding)
+
+LayoutStruct(Circle, CircleLayout)
+LayoutStruct(Rect, RectLayout)
+LayoutStruct(Line2D, Line2DLayout)
+LayoutStruct(Line, LineLayout)
+LayoutStruct(Point, PointLayout)
+
+LayoutCheck(Circle, CircleLayout)
+LayoutCheck(Rect, RectLayout)
+LayoutCheck(Line2D, Line2DLayout)
+LayoutCheck(Line, LineLayout)
+LayoutCheck(Point, PointLayout)
+
+// The most instances of each primitive type that can be allocated
+#define PolygonMaxCount 65536
+
+typedef enum PolygonCullMode
 {
-    vec3 position;
-    float pointSize;
-    vec3 color;
-    float padding;
-} Point;
-
-// Represents some z = f(x, y)
-// The grid is n x n
-// TODO: refactor this to redefine the origin to the center of the surface
-// Instead of scale, allow the user to define a surface width dimension
-// TODO: allow for rectangular domains instead of just square
-typedef struct Surface
-{
-    vec3 origin; // The coordinates of the top left corner in world space
-    float scale; // The spacing between subsequent elements in the grid
-    float* vertices; // Vertex data (height, r, g, b). (x, y) -> vertices[x + y * n]
-    VertexArray vertexArray;
-    uint32_t n; // The number of elements along each dimension
-} Surface;
+    PolygonCullNone, // Every allocated instance is uploaded and drawn
+    PolygonCullCPU, // Instances outside the view frustum are culled before upload
+    PolygonCullGPU, // Instances stay resident and are culled by a compute shader
+} PolygonCullMode;
 
 // Initializes polygons; must be called before other functions
 void PolygonInitialize();
@@ -92,12 +96,18 @@ Line* PolygonLines(unsigned int count);
 
 // TODO: methods for getting point objects
 
-void SurfaceInitialize(Surface* surface, vec3 origin, float scale, float* data, uint32_t n);
-
-void SurfaceDraw(Surface* surface);
-
 // Updates the view-perspective matrix used to transform polygons
 void PolygonUpdateViewPerspectiveMatrix(mat4 vpMatrix);
 
 // Renders polygons
-void PolygonRenderPolygons();
\ No newline at end of file
+void PolygonRenderPolygons();
+
+// Selects how instances outside the view are culled
+void PolygonSetCullMode(PolygonCullMode mode);
+
+// Marks instances modified through returned pointers for upload (PolygonCullGPU)
+void PolygonMarkDirty();
+
+// Gets the number of instances drawn and allocated in the last frame
+// The drawn count lags by a frame or more when culling on the GPU
+void PolygonGetCullStats(unsigned int* visibleCount, unsigned int* totalCount);
\ No newline at end of file
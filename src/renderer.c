@@ -3,13 +3,175 @@
 #include "renderer.h"
 #include "debug.h"
 
+// Marks a cached binding whose value is not known (e.g. after a VAO switch)
+#define UnknownBinding 0xFFFFFFFF
+
+// Buffer targets whose bindings are tracked by the state cache
+static const GLenum CachedBufferTargets[] =
+{
+    GL_ARRAY_BUFFER,
+    GL_ELEMENT_ARRAY_BUFFER,
+    GL_UNIFORM_BUFFER,
+    GL_SHADER_STORAGE_BUFFER,
+    GL_DRAW_INDIRECT_BUFFER,
+    GL_PIXEL_PACK_BUFFER,
+    GL_PIXEL_UNPACK_BUFFER,
+    GL_COPY_READ_BUFFER,
+    GL_COPY_WRITE_BUFFER,
+};
+#define CachedBufferTargetCount (sizeof(CachedBufferTargets) / sizeof(CachedBufferTargets[0]))
+
 static unsigned int NextUniformBufferBindingPoint = 0;
+static unsigned int NextStorageBufferBindingPoint = 0;
+
+static unsigned int boundProgram = UnknownBinding;
+static unsigned int boundVertexArray = UnknownBinding;
+static unsigned int boundBuffers[CachedBufferTargetCount] =
+{
+    UnknownBinding, UnknownBinding, UnknownBinding, UnknownBinding, UnknownBinding,
+    UnknownBinding, UnknownBinding, UnknownBinding, UnknownBinding,
+};
+
+static RendererStateStats frameStats;
+static RendererStateStats lastFrameStats;
 
 static unsigned int GetNextUniformBufferBindingPoint()
 {
     return NextUniformBufferBindingPoint++;
 }
 
+// Gets GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, which is at least 8
+static unsigned int GetMaxStorageBufferBindings()
+{
+    static GLint maxBindings = 0;
+    if (maxBindings == 0)
+    {
+        GLCall(glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings));
+    }
+
+    return maxBindings;
+}
+
+// Returns RendererNoBindingPoint if every binding point is in use
+static unsigned int GetNextStorageBufferBindingPoint()
+{
+    if (NextStorageBufferBindingPoint >= GetMaxStorageBufferBindings())
+    {
+        printf("Error: all %u shader storage binding points are in use\n", GetMaxStorageBufferBindings());
+        return RendererNoBindingPoint;
+    }
+
+    return NextStorageBufferBindingPoint++;
+}
+
+// Gets the number of shader storage binding points that can still be given out
+unsigned int RendererFreeStorageBindingPoints()
+{
+    unsigned int maxBindings = GetMaxStorageBufferBindings();
+    return NextStorageBufferBindingPoint < maxBindings ? maxBindings - NextStorageBufferBindingPoint : 0;
+}
+
+// Returns the slot of `target` in the buffer binding cache, or -1 if untracked
+static int GetBufferTargetSlot(GLenum target)
+{
+    for (int i = 0; i < CachedBufferTargetCount; i++)
+    {
+        if (CachedBufferTargets[i] == target) return i;
+    }
+
+    return -1;
+}
+
+// Records a binding made by a call that also binds the generic target,
+// such as glBindBufferBase
+static void RecordBufferBinding(GLenum target, unsigned int bufferId)
+{
+    int slot = GetBufferTargetSlot(target);
+    if (slot >= 0) boundBuffers[slot] = bufferId;
+}
+
+// Makes `programId` the current program unless it already is
+void RendererUseProgram(unsigned int programId)
+{
+    frameStats.programBinds++;
+    if (boundProgram == programId)
+    {
+        frameStats.programBindsElided++;
+        return;
+    }
+
+    GLCall(glUseProgram(programId));
+    boundProgram = programId;
+}
+
+// Binds the vertex array unless it is already bound
+void RendererBindVertexArray(unsigned int vertexArrayId)
+{
+    frameStats.vertexArrayBinds++;
+    if (boundVertexArray == vertexArrayId)
+    {
+        frameStats.vertexArrayBindsElided++;
+        return;
+    }
+
+    GLCall(glBindVertexArray(vertexArrayId));
+    boundVertexArray = vertexArrayId;
+
+    // The element array binding is part of the vertex array state
+    boundBuffers[GetBufferTargetSlot(GL_ELEMENT_ARRAY_BUFFER)] = UnknownBinding;
+}
+
+// Binds the buffer to `target` unless it is already bound there
+void RendererBindBuffer(GLenum target, unsigned int bufferId)
+{
+    frameStats.bufferBinds++;
+    int slot = GetBufferTargetSlot(target);
+    if (slot >= 0 && boundBuffers[slot] == bufferId)
+    {
+        frameStats.bufferBindsElided++;
+        return;
+    }
+
+    GLCall(glBindBuffer(target, bufferId));
+    if (slot >= 0) boundBuffers[slot] = bufferId;
+}
+
+// Deleting a bound buffer reverts its bindings to zero
+// Must be called before a buffer is deleted
+void RendererForgetBuffer(unsigned int bufferId)
+{
+    for (int i = 0; i < CachedBufferTargetCount; i++)
+    {
+        if (boundBuffers[i] == bufferId) boundBuffers[i] = 0;
+    }
+}
+
+// Discards all cached bindings. Call after binding state is changed
+// without going through the renderer
+void RendererInvalidateState()
+{
+    boundProgram = UnknownBinding;
+    boundVertexArray = UnknownBinding;
+    for (int i = 0; i < CachedBufferTargetCount; i++)
+    {
+        boundBuffers[i] = UnknownBinding;
+    }
+}
+
+// Publishes the state change counts of the current frame and resets them
+// Should be called at the end of every frame
+void RendererEndFrame()
+{
+    lastFrameStats = frameStats;
+    memset(&frameStats, 0, sizeof(RendererStateStats));
+}
+
+// Gets the state change counts of the last completed frame
+void RendererGetFrameStats(RendererStateStats* stats)
+{
+    *stats = lastFrameStats;
+}
+
 void VertexArrayInitialize(VertexArray* vertexArray)
 {
     memset(vertexArray, 0, sizeof(VertexArray));
@@ -18,25 +180,26 @@ void VertexArrayInitialize(VertexArray* vertexArray)
 
 void VertexArrayBind(VertexArray* vertexArray)
 {
-    GLCall(glBindVertexArray(vertexArray->id));
+    RendererBindVertexArray(vertexArray->id);
 }
 
 void VertexArrayUnbind()
 {
-    GLCall(glBindVertexArray(0));
+    RendererBindVertexArray(0);
 }
 
 // Deletes the vertex array but does not alter the associated buffers
 void VertexArrayDelete(VertexArray* vertexArray)
 {
+    if (boundVertexArray == vertexArray->id) RendererBindVertexArray(0);
     GLCall(glDeleteVertexArrays(1, &vertexArray->id));
 }
 
-void VertexBufferInitialize(VertexArray* vertexArray, void* data, unsigned int size, GLenum usage)
+void VertexBufferInitialize(VertexArray* vertexArray, void* data, size_t size, GLenum usage)
 {
     unsigned int* vertexBufferId = &vertexArray->vertexBufferId;
     GLCall(glGenBuffers(1, vertexBufferId));
-    GLCall(glBindBuffer(GL_ARRAY_BUFFER, *vertexBufferId));
+    RendererBindBuffer(GL_ARRAY_BUFFER, *vertexBufferId);
     GLCall(glBufferData(GL_ARRAY_BUFFER, size, data, usage));
 
     // TODO: make an optional init method that marks whether the 
@@ -56,26 +219,46 @@ void VertexBufferUpdate(VertexArray* vertexArray)
     GLCall(glUnmapBuffer(GL_ARRAY_BUFFER));
 }
 
-void VertexBufferUpdateRange(VertexArray* vertexArray, unsigned int offset, unsigned int size)
+// Uploads `size` bytes of the vertex data starting at `offset`
+// The rest of the buffer is left untouched
+void VertexBufferUpdateRange(VertexArray* vertexArray, size_t offset, size_t size)
 {
+    if (size == 0) return;
+
     VertexBufferBind(vertexArray);
-    GLCall(void* mappedBuffer = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+    GLCall(void* mappedBuffer = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
     memcpy(mappedBuffer, (char*)(vertexArray->vertexBufferData) + offset, size);
     GLCall(glUnmapBuffer(GL_ARRAY_BUFFER));
 }
 
+// Uploads `count` blocks of `size` bytes of the vertex data, `stride` bytes apart,
+// starting at `offset`; e.g. a column range of consecutive grid rows
+void VertexBufferUpdateStrided(VertexArray* vertexArray, size_t offset, size_t size, size_t stride,
+    unsigned int count)
+{
+    VertexBufferBind(vertexArray);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        size_t blockOffset = offset + i * stride;
+        GLCall(glBufferSubData(GL_ARRAY_BUFFER, blockOffset, size,
+            (char*)(vertexArray->vertexBufferData) + blockOffset));
+    }
+}
+
 void VertexBufferBind(VertexArray* vertexArray)
 {
-    GLCall(glBindBuffer(GL_ARRAY_BUFFER, vertexArray->vertexBufferId));
+    RendererBindBuffer(GL_ARRAY_BUFFER, vertexArray->vertexBufferId);
 }
 
 void VertexBufferUnbind()
 {
-    GLCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    RendererBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void VertexBufferDelete(VertexArray* vertexArray)
 {
+    RendererForgetBuffer(vertexArray->vertexBufferId);
     GLCall(glDeleteBuffers(1, &vertexArray->vertexBufferId));
 }
 
@@ -83,25 +266,36 @@ void IndexBufferInitialize(VertexArray* vertexArray, unsigned int* data, unsigne
 {
     unsigned int* indexBufferId = &vertexArray->indexBufferId;
     GLCall(glGenBuffers(1, indexBufferId));
-    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *indexBufferId));
+    RendererBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *indexBufferId);
     GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), data, usage));
 
     vertexArray->indexBufferData = data;
     vertexArray->indexBufferCount = count;
 }
 
+// Uses an index buffer created for another vertex array; the vertex array must be bound
+void IndexBufferAttach(VertexArray* vertexArray, unsigned int indexBufferId, unsigned int count)
+{
+    vertexArray->indexBufferId = indexBufferId;
+    RendererBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferId);
+
+    vertexArray->indexBufferData = NULL;
+    vertexArray->indexBufferCount = count;
+}
+
 void IndexBufferBind(VertexArray* vertexArray)
 {
-    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexArray->indexBufferId));
+    RendererBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexArray->indexBufferId);
 }
 
 void IndexBufferUnbind()
 {
-    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+    RendererBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void IndexBufferDelete(VertexArray* vertexArray)
 {
+    RendererForgetBuffer(vertexArray->indexBufferId);
     GLCall(glDeleteBuffers(1, &vertexArray->indexBufferId));
 }
 
@@ -112,16 +306,17 @@ void UniformBufferInitialize(UniformBuffer* uniformBuffer, void* data, unsigned
     unsigned int bindingPoint = GetNextUniformBufferBindingPoint();
     uniformBuffer->bindingPoint = bindingPoint;
     GLCall(glGenBuffers(1, &uniformBuffer->bufferId));
-    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId));
+    RendererBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId);
     GLCall(glBufferData(GL_UNIFORM_BUFFER, size, data, usageHint));
     GLCall(glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, uniformBuffer->bufferId));
+    RecordBufferBinding(GL_UNIFORM_BUFFER, uniformBuffer->bufferId);
 }
 
 void UniformBufferUpdate(UniformBuffer* uniformBuffer)
 {
     // TODO: investigate glMapBuffer vs glBufferSubData performance
 
-    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId));
+    RendererBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId);
     GLCall(void* mappedBuffer = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY));
     memcpy(mappedBuffer, uniformBuffer->data, uniformBuffer->size);
     GLCall(glUnmapBuffer(GL_UNIFORM_BUFFER));
@@ -130,32 +325,261 @@ void UniformBufferUpdate(UniformBuffer* uniformBuffer)
 void UniformBufferUpdateRange(UniformBuffer* uniformBuffer, unsigned int offset,
     unsigned int size)
 {
-    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId));
-    GLCall(void* mappedBuffer = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY));
+    RendererBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId);
+    GLCall(void* mappedBuffer = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
     memcpy(mappedBuffer, (char*)(uniformBuffer->data) + offset, size);
     GLCall(glUnmapBuffer(GL_UNIFORM_BUFFER));
 }
 
 void UniformBufferBind(UniformBuffer* uniformBuffer)
 {
-    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId));
+    RendererBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer->bufferId);
 }
 
 void UniformBufferUnbind()
 {
-    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+    RendererBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void UniformBufferDelete(UniformBuffer* uniformBuffer)
 {
+    RendererForgetBuffer(uniformBuffer->bufferId);
     GLCall(glDeleteBuffers(1, &uniformBuffer->bufferId));
 }
 
+void StorageBufferInitialize(StorageBuffer* storageBuffer, void* data, unsigned int size, GLenum usageHint)
+{
+    storageBuffer->data = data;
+    storageBuffer->size = size;
+    unsigned int bindingPoint = GetNextStorageBufferBindingPoint();
+    storageBuffer->bindingPoint = bindingPoint;
+    GLCall(glGenBuffers(1, &storageBuffer->bufferId));
+    RendererBindBuffer(GL_SHADER_STORAGE_BUFFER, storageBuffer->bufferId);
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usageHint));
+    if (bindingPoint == RendererNoBindingPoint) return;
+
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, storageBuffer->bufferId));
+    RecordBufferBinding(GL_SHADER_STORAGE_BUFFER, storageBuffer->bufferId);
+}
+
+void StorageBufferUpdate(StorageBuffer* storageBuffer)
+{
+    StorageBufferUpdateRange(storageBuffer, 0, storageBuffer->size);
+}
+
+// Uploads `size` bytes of the buffer's data starting at `offset`
+// The rest of the buffer is left untouched
+void StorageBufferUpdateRange(StorageBuffer* storageBuffer, unsigned int offset, unsigned int size)
+{
+    if (size == 0) return;
+
+    RendererBindBuffer(GL_SHADER_STORAGE_BUFFER, storageBuffer->bufferId);
+    GLCall(void* mappedBuffer = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, offset, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+    memcpy(mappedBuffer, (char*)(storageBuffer->data) + offset, size);
+    GLCall(glUnmapBuffer(GL_SHADER_STORAGE_BUFFER));
+}
+
+// Binds part of the buffer to a new binding point and returns the binding point,
+// or RendererNoBindingPoint if none is left
+// `offset` must be a multiple of GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+unsigned int StorageBufferBindRange(StorageBuffer* storageBuffer, unsigned int offset, unsigned int size)
+{
+    unsigned int bindingPoint = GetNextStorageBufferBindingPoint();
+    if (bindingPoint == RendererNoBindingPoint) return bindingPoint;
+
+    GLCall(glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingPoint, storageBuffer->bufferId,
+        offset, size));
+    RecordBufferBinding(GL_SHADER_STORAGE_BUFFER, storageBuffer->bufferId);
+    return bindingPoint;
+}
+
+void StorageBufferBind(StorageBuffer* storageBuffer)
+{
+    RendererBindBuffer(GL_SHADER_STORAGE_BUFFER, storageBuffer->bufferId);
+}
+
+void StorageBufferUnbind()
+{
+    RendererBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void StorageBufferDelete(StorageBuffer* storageBuffer)
+{
+    RendererForgetBuffer(storageBuffer->bufferId);
+    GLCall(glDeleteBuffers(1, &storageBuffer->bufferId));
+}
+
+void IndirectBufferInitialize(IndirectBuffer* indirectBuffer, DrawArraysIndirectCommand* commands,
+    unsigned int commandCount, GLenum usageHint)
+{
+    unsigned int size = commandCount * sizeof(DrawArraysIndirectCommand);
+    indirectBuffer->commands = commands;
+    indirectBuffer->size = size;
+    GLCall(glGenBuffers(1, &indirectBuffer->bufferId));
+    RendererBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer->bufferId);
+    GLCall(glBufferData(GL_DRAW_INDIRECT_BUFFER, size, commands, usageHint));
+}
+
+void IndirectBufferInitializeElements(IndirectBuffer* indirectBuffer,
+    DrawElementsIndirectCommand* commands, unsigned int commandCount, GLenum usageHint)
+{
+    unsigned int size = commandCount * sizeof(DrawElementsIndirectCommand);
+    indirectBuffer->commands = commands;
+    indirectBuffer->size = size;
+    GLCall(glGenBuffers(1, &indirectBuffer->bufferId));
+    RendererBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer->bufferId);
+    GLCall(glBufferData(GL_DRAW_INDIRECT_BUFFER, size, commands, usageHint));
+}
+
+void IndirectBufferUpdate(IndirectBuffer* indirectBuffer)
+{
+    RendererBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer->bufferId);
+    GLCall(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, indirectBuffer->size, indirectBuffer->commands));
+}
+
+// Uploads part of the commands; offset and size in bytes
+void IndirectBufferUpdateRange(IndirectBuffer* indirectBuffer, unsigned int offset, unsigned int size)
+{
+    RendererBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer->bufferId);
+    GLCall(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offset, size,
+        (char*)indirectBuffer->commands + offset));
+}
+
+// Binds the commands to a new storage binding point so that shaders can write them
+// Returns the binding point, or RendererNoBindingPoint if none is left
+unsigned int IndirectBufferBindStorage(IndirectBuffer* indirectBuffer)
+{
+    unsigned int bindingPoint = GetNextStorageBufferBindingPoint();
+    if (bindingPoint == RendererNoBindingPoint) return bindingPoint;
+
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, indirectBuffer->bufferId));
+    RecordBufferBinding(GL_SHADER_STORAGE_BUFFER, indirectBuffer->bufferId);
+    return bindingPoint;
+}
+
+void IndirectBufferBind(IndirectBuffer* indirectBuffer)
+{
+    RendererBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer->bufferId);
+}
+
+void IndirectBufferUnbind()
+{
+    RendererBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void IndirectBufferDelete(IndirectBuffer* indirectBuffer)
+{
+    RendererForgetBuffer(indirectBuffer->bufferId);
+    GLCall(glDeleteBuffers(1, &indirectBuffer->bufferId));
+}
+
+// Creates a framebuffer with RGBA8 color and 24 bit depth, multisampled if `samples` > 0
+// Returns 0 if the framebuffer is incomplete
+int FramebufferInitialize(Framebuffer* framebuffer, int width, int height, int samples)
+{
+    framebuffer->width = width;
+    framebuffer->height = height;
+    framebuffer->samples = samples;
+
+    GLCall(glGenRenderbuffers(1, &framebuffer->colorRenderbufferId));
+    GLCall(glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->colorRenderbufferId));
+    GLCall(glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height));
+
+    GLCall(glGenRenderbuffers(1, &framebuffer->depthRenderbufferId));
+    GLCall(glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->depthRenderbufferId));
+    GLCall(glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height));
+
+    GLCall(glGenFramebuffers(1, &framebuffer->id));
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id));
+    GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+        framebuffer->colorRenderbufferId));
+    GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+        framebuffer->depthRenderbufferId));
+
+    GLenum status;
+    GLCall(status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("Framebuffer is incomplete: 0x%x\n", status);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Directs drawing and reading to the framebuffer and covers it with the viewport
+void FramebufferBind(Framebuffer* framebuffer)
+{
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id));
+    GLCall(glViewport(0, 0, framebuffer->width, framebuffer->height));
+}
+
+// Directs drawing and reading back to the window
+void FramebufferUnbind()
+{
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+// Copies the color of `source` into `destination`, resolving its samples
+// Leaves `destination` bound for reading
+void FramebufferResolve(Framebuffer* source, Framebuffer* destination)
+{
+    GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, source->id));
+    GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination->id));
+    GLCall(glBlitFramebuffer(0, 0, source->width, source->height, 0, 0,
+        destination->width, destination->height, GL_COLOR_BUFFER_BIT, GL_NEAREST));
+    GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, destination->id));
+}
+
+void FramebufferDelete(Framebuffer* framebuffer)
+{
+    GLCall(glDeleteFramebuffers(1, &framebuffer->id));
+    GLCall(glDeleteRenderbuffers(1, &framebuffer->colorRenderbufferId));
+    GLCall(glDeleteRenderbuffers(1, &framebuffer->depthRenderbufferId));
+}
+
 // Enables and configures an attribute at the specified index
 // The attribute is a series of floats (number specified by size)
+// Stride and offset in bytes, the offset from the start of each vertex
+void VertexAttribPointerFloats(unsigned int index, int size, int stride, size_t offset)
+{
+    GLCall(glEnableVertexAttribArray(index));
+    GLCall(glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, stride, (void*)offset));
+}
+
+// Enables and configures an integer attribute at the specified index
+// The attribute is a series of unsigned ints (number specified by size)
+// Stride in bytes
+void VertexAttribPointerUInts(unsigned int index, int size, int stride)
+{
+    GLCall(glEnableVertexAttribArray(index));
+    GLCall(glVertexAttribIPointer(index, size, GL_UNSIGNED_INT, stride, (void*)0));
+}
+
+// Enables and configures an attribute at the specified index
+// The attribute is a series of unsigned bytes (number specified by size) read as [0, 1] floats
 // Stride in bytes
-void VertexAttribPointerFloats(unsigned int index, int size, int stride)
+void VertexAttribPointerNormalizedUBytes(unsigned int index, int size, int stride)
 {
     GLCall(glEnableVertexAttribArray(index));
-    GLCall(glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * index)));
+    GLCall(glVertexAttribPointer(index, size, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)0));
+}
+
+// Enables and configures an attribute at the specified index
+// The attribute is four signed values packed as GL_INT_2_10_10_10_REV read as [-1, 1] floats
+// Stride in bytes
+void VertexAttribPointerPackedNormals(unsigned int index, int stride)
+{
+    GLCall(glEnableVertexAttribArray(index));
+    GLCall(glVertexAttribPointer(index, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)0));
+}
+
+// Sets the number of instances drawn per attribute value; zero for per vertex values
+void VertexAttribDivisor(unsigned int index, unsigned int divisor)
+{
+    GLCall(glVertexAttribDivisor(index, divisor));
 }
\ No newline at end of file
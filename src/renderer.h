@@ -6,7 +6,7 @@
 typedef struct VertexArray
 {
     unsigned int vertexBufferId;
-    unsigned int vertexBufferSize;
+    size_t vertexBufferSize;
     void* vertexBufferData;
 
     unsigned int indexBufferId;
@@ -24,27 +24,91 @@ typedef struct UniformBuffer
     void* data;
 } UniformBuffer;
 
+// Given in place of a storage binding point once GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS are in use
+#define RendererNoBindingPoint 0xFFFFFFFF
+
 typedef struct StorageBuffer
 {
     unsigned int bufferId;
     unsigned int size;
-    unsigned int bindingPoint;
+    unsigned int bindingPoint; // RendererNoBindingPoint if none was left
     void* data;
 } StorageBuffer;
 
+// Layout of a single draw read by glMultiDrawArraysIndirect
+typedef struct DrawArraysIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int first;
+    unsigned int baseInstance;
+} DrawArraysIndirectCommand;
+
+// Layout of a single draw read by glMultiDrawElementsIndirect
+typedef struct DrawElementsIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+} DrawElementsIndirectCommand;
+
+typedef struct IndirectBuffer
+{
+    unsigned int bufferId;
+    unsigned int size;
+    void* commands; // DrawArraysIndirectCommand or DrawElementsIndirectCommand
+} IndirectBuffer;
+
+// An offscreen render target with color and depth renderbuffers
+typedef struct Framebuffer
+{
+    unsigned int id;
+    unsigned int colorRenderbufferId;
+    unsigned int depthRenderbufferId;
+    int width;
+    int height;
+    int samples; // Zero if the renderbuffers are not multisampled
+} Framebuffer;
+
+// Counts of state changes requested through the renderer and how many of
+// those were skipped because the state was already current
+typedef struct RendererStateStats
+{
+    unsigned int programBinds;
+    unsigned int programBindsElided;
+    unsigned int vertexArrayBinds;
+    unsigned int vertexArrayBindsElided;
+    unsigned int bufferBinds;
+    unsigned int bufferBindsElided;
+} RendererStateStats;
+
+void RendererUseProgram(unsigned int programId);
+void RendererBindVertexArray(unsigned int vertexArrayId);
+void RendererBindBuffer(GLenum target, unsigned int bufferId);
+void RendererForgetBuffer(unsigned int bufferId);
+void RendererInvalidateState();
+void RendererEndFrame();
+void RendererGetFrameStats(RendererStateStats* stats);
+unsigned int RendererFreeStorageBindingPoints();
+
 void VertexArrayInitialize(VertexArray* vertexArray);
 void VertexArrayBind(VertexArray* vertexArray);
 void VertexArrayUnbind();
 void VertexArrayDelete(VertexArray* vertexArray);
 
-void VertexBufferInitialize(VertexArray* vertexArray, void* data, unsigned int size, GLenum usage);
+void VertexBufferInitialize(VertexArray* vertexArray, void* data, size_t size, GLenum usage);
 void VertexBufferUpdate(VertexArray* vertexArray);
-void VertexBufferUpdateRange(VertexArray* vertexArray, unsigned int offset, unsigned int size);
+void VertexBufferUpdateRange(VertexArray* vertexArray, size_t offset, size_t size);
+void VertexBufferUpdateStrided(VertexArray* vertexArray, size_t offset, size_t size, size_t stride,
+    unsigned int count);
 void VertexBufferBind(VertexArray* vertexArray);
 void VertexBufferUnbind();
 void VertexBufferDelete(VertexArray* vertexArray);
 
 void IndexBufferInitialize(VertexArray* vertexArray, unsigned int* data, unsigned int count, GLenum usage);
+void IndexBufferAttach(VertexArray* vertexArray, unsigned int indexBufferId, unsigned int count);
 void IndexBufferBind(VertexArray* vertexArray);
 void IndexBufferUnbind();
 void IndexBufferDelete(VertexArray* vertexArray);
@@ -56,4 +120,33 @@ void UniformBufferBind(UniformBuffer* uniformBuffer);
 void UniformBufferUnbind();
 void UniformBufferDelete(UniformBuffer* uniformBuffer);
 
-void VertexAttribPointerFloats(unsigned int index, int size, int stride);
\ No newline at end of file
+void StorageBufferInitialize(StorageBuffer* storageBuffer, void* data, unsigned int size, GLenum usageHint);
+void StorageBufferUpdate(StorageBuffer* storageBuffer);
+void StorageBufferUpdateRange(StorageBuffer* storageBuffer, unsigned int offset, unsigned int size);
+unsigned int StorageBufferBindRange(StorageBuffer* storageBuffer, unsigned int offset, unsigned int size);
+void StorageBufferBind(StorageBuffer* storageBuffer);
+void StorageBufferUnbind();
+void StorageBufferDelete(StorageBuffer* storageBuffer);
+
+void IndirectBufferInitialize(IndirectBuffer* indirectBuffer, DrawArraysIndirectCommand* commands,
+    unsigned int commandCount, GLenum usageHint);
+void IndirectBufferInitializeElements(IndirectBuffer* indirectBuffer,
+    DrawElementsIndirectCommand* commands, unsigned int commandCount, GLenum usageHint);
+void IndirectBufferUpdate(IndirectBuffer* indirectBuffer);
+void IndirectBufferUpdateRange(IndirectBuffer* indirectBuffer, unsigned int offset, unsigned int size);
+unsigned int IndirectBufferBindStorage(IndirectBuffer* indirectBuffer);
+void IndirectBufferBind(IndirectBuffer* indirectBuffer);
+void IndirectBufferUnbind();
+void IndirectBufferDelete(IndirectBuffer* indirectBuffer);
+
+int FramebufferInitialize(Framebuffer* framebuffer, int width, int height, int samples);
+void FramebufferBind(Framebuffer* framebuffer);
+void FramebufferUnbind();
+void FramebufferResolve(Framebuffer* source, Framebuffer* destination);
+void FramebufferDelete(Framebuffer* framebuffer);
+
+void VertexAttribPointerFloats(unsigned int index, int size, int stride, size_t offset);
+void VertexAttribPointerUInts(unsigned int index, int size, int stride);
+void VertexAttribPointerNormalizedUBytes(unsigned int index, int size, int stride);
+void VertexAttribPointerPackedNormals(unsigned int index, int stride);
+void VertexAttribDivisor(unsigned int index, unsigned int divisor);
\ No newline at end of file
@@ -1,10 +1,154 @@
 #define GLEW_STATIC
 #include <GL\glew.h>
+#include <GLFW\glfw3.h>
 #include <stdio.h>
 #include <malloc.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define MakeDirectory(path) _mkdir(path)
+#else
+#define MakeDirectory(path) mkdir(path, 0755)
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 #include "shader.h"
 #include "debug.h"
 #include "renderer.h"
+#include "parallel.h"
+#include "arena.h"
+
+// A uniform location or uniform block index resolved by name
+// Uniforms also remember the last value set through the shader module, which is
+// set again when the program is reloaded
+typedef struct ShaderName
+{
+    char* name; // NULL for empty slots
+    uint32_t hash;
+    int location;
+    bool valueKnown;
+    GLenum valueType; // GL_INT, GL_UNSIGNED_INT, GL_FLOAT, GL_FLOAT_VEC2 or GL_FLOAT_VEC3
+    unsigned int valueCount; // Array elements
+    unsigned char value[ShaderMaxUniformValueSize];
+} ShaderName;
+
+// Open addressed table of names; the capacity is a power of two
+typedef struct ShaderNameTable
+{
+    ShaderName* entries;
+    unsigned int capacity;
+    unsigned int count;
+} ShaderNameTable;
+
+// A block binding made through the shader module, restored when a program is reloaded
+typedef struct ShaderBlockBinding
+{
+    char* name;
+    unsigned int bindingPoint;
+    bool storage; // A shader storage block rather than a uniform block
+} ShaderBlockBinding;
+
+// The names of a program, resolved when it is linked
+typedef struct ShaderProgram
+{
+    unsigned int id;
+    ShaderNameTable uniforms;
+    ShaderNameTable blocks;
+
+    // Programs created from files are rebuilt when the files change
+    unsigned int stageCount;
+    unsigned int types[2];
+    char* filePaths[2];
+    time_t modifiedTimes[2];
+    char* templateMarker; // Replaced by templateInsert in the vertex shader, if set
+    char* templateInsert;
+    ShaderBlockBinding* bindings;
+    unsigned int bindingCount;
+
+    // A rebuild in progress: a separate program that replaces this one once it links
+    unsigned int rebuildId;
+    unsigned int rebuildShaderIds[2];
+    uint64_t rebuildKey;
+    struct ShaderBuild* build; // Queued on the rebuild thread; gives rebuildId once complete
+
+    struct ShaderProgram* next;
+} ShaderProgram;
+
+static ShaderProgram* programs;
+static ShaderProgram* lastProgram; // Lookups usually repeat the same program
+
+// Sources substituted for #include lines, see ShaderDefineInclude
+typedef struct ShaderInclude
+{
+    const char* name;
+    const char* source;
+    struct ShaderInclude* next;
+} ShaderInclude;
+
+static ShaderInclude* includes;
+
+// Hot reloading watches this directory, through inotify where available and otherwise
+// by polling the modification times of the program files every few updates
+static char* watchedDirectory;
+static int inotifyFd = -1;
+static unsigned int pollCountdown;
+static bool parallelRebuilds; // GL_KHR_parallel_shader_compile lets rebuilds finish in the background
+
+#define ShaderPollInterval 30
+
+// A rebuild compiled and linked on the rebuild thread, which has its own context sharing
+// objects with the main one, for drivers that compile on the calling thread
+typedef struct ShaderBuild
+{
+    unsigned int stageCount;
+    unsigned int types[2];
+    char* sources[2]; // Freed by the rebuild thread
+    unsigned int programId; // Set by the rebuild thread
+    unsigned int shaderIds[2];
+    atomic_bool complete;
+    bool abandoned; // The rebuild thread deletes abandoned builds once complete
+    struct ShaderBuild* next;
+} ShaderBuild;
+
+static GLFWwindow* rebuildContext;
+static pthread_t rebuildThread;
+static pthread_mutex_t buildMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t buildQueued = PTHREAD_COND_INITIALIZER;
+static ShaderBuild* buildQueue; // Guarded by buildMutex, as are abandoned and stopBuilding
+static bool stopBuilding;
+
+// Linked programs are saved here and reloaded instead of compiling when their sources
+// and the driver are unchanged
+static const char* ShaderCacheDirectory = "shader_cache";
+
+#define ProgramBinaryMagic 0x42505347 // "GSPB"
+
+// Precedes the program binary in a cache file
+typedef struct ProgramBinaryHeader
+{
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+} ProgramBinaryHeader;
+
+static int programBinaryFormatCount = -1;
+
+// Returns the length of an open file and rewinds it
+static long GetOpenFileLength(FILE* file)
+{
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    return length > 0 ? length : 0;
+}
 
 static long GetFileLength(const char* filePath)
 {
@@ -12,43 +156,353 @@ static long GetFileLength(const char* filePath)
     if (file == NULL)
         return 0;
 
-    fseek(file, 0, SEEK_END);
-    return ftell(file);
+    long length = GetOpenFileLength(file);
+    fclose(file);
+    return length;
+}
+
+// Reads at most capacity - 1 bytes of an open file into the buffer and terminates it
+static void ReadOpenFile(FILE* file, char* buffer, long capacity)
+{
+    size_t length = fread(buffer, 1, capacity - 1, file);
+    buffer[length] = '\0';
 }
 
-// Loads the file at filePath into the buffer passed in
-// Call GetFileLength first to know how large the buffer should be
-static void ShaderLoad(const char* filePath, char* buffer)
+// Loads the file at filePath into the buffer passed in, which holds `capacity` bytes
+// The file may have grown since the buffer was sized, e.g. while an editor saves it,
+// so anything past the capacity is left out
+static void ShaderLoad(const char* filePath, char* buffer, long capacity)
 {
     FILE* file = fopen(filePath, "r");
 
     if (file == NULL)
     {
         printf("Error opening file at path: %s\n", filePath);
+        buffer[0] = '\0';
+        return;
     }
 
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
+    ReadOpenFile(file, buffer, capacity);
+    fclose(file);
+}
 
-    fseek(file, 0, SEEK_SET);
-    long actualLength = fread(buffer, 1, length, file);
-    buffer[actualLength] = '\0';
+static const ShaderInclude* FindInclude(const char* name, size_t length)
+{
+    for (const ShaderInclude* include = includes; include; include = include->next)
+    {
+        if (strncmp(include->name, name, length) == 0 && include->name[length] == '\0') return include;
+    }
+
+    return NULL;
+}
 
+// Replaces each `#include "name"` line of the source with the defined include
+// Returns the source itself if it has none; otherwise the expansion allocated from the arena
+static char* ExpandIncludes(Arena* arena, char* source, const char* filePath)
+{
+    static const char* Directive = "#include \"";
+    size_t directiveLength = strlen(Directive);
+
+    char* line = strstr(source, Directive);
+    if (line == NULL) return source;
+
+    size_t prefixLength = line - source;
+    const char* name = line + directiveLength;
+    const char* nameEnd = strchr(name, '"');
+    if (nameEnd == NULL) return source;
+
+    const ShaderInclude* include = FindInclude(name, nameEnd - name);
+    if (include == NULL)
+    {
+        printf("No include named '%.*s' is defined for '%s'\n", (int)(nameEnd - name), name, filePath);
+        return source;
+    }
+
+    const char* suffix = nameEnd + 1;
+    size_t includeLength = strlen(include->source);
+    char* expanded = ArenaAlloc(arena, prefixLength + includeLength + strlen(suffix) + 1);
+    memcpy(expanded, source, prefixLength);
+    memcpy(expanded + prefixLength, include->source, includeLength);
+    strcpy(expanded + prefixLength + includeLength, suffix);
+
+    // Includes may include others; the rest of the file is searched again
+    return ExpandIncludes(arena, expanded, filePath);
+}
+
+// Returns the contents of the file at filePath with includes expanded, allocated from the arena
+// The buffer is sized through the same handle the file is read from
+static char* ShaderLoadSource(Arena* arena, const char* filePath)
+{
+    FILE* file = fopen(filePath, "r");
+    if (file == NULL)
+    {
+        printf("Error opening file at path: %s\n", filePath);
+        char* empty = ArenaAlloc(arena, 1);
+        empty[0] = '\0';
+        return empty;
+    }
+
+    long capacity = GetOpenFileLength(file) + 1;
+    char* buffer = ArenaAlloc(arena, capacity);
+    ReadOpenFile(file, buffer, capacity);
     fclose(file);
+
+    return ExpandIncludes(arena, buffer, filePath);
+}
+
+void ShaderDefineInclude(const char* name, const char* source)
+{
+    ShaderInclude* include = malloc(sizeof(ShaderInclude));
+    include->name = name;
+    include->source = source;
+    include->next = includes;
+    includes = include;
+}
+
+// FNV-1a
+static uint32_t HashName(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (; *name; name++)
+    {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void NameTableInitialize(ShaderNameTable* table, unsigned int count)
+{
+    unsigned int capacity = 8;
+    while (capacity < 2 * count) capacity *= 2;
+
+    table->entries = calloc(capacity, sizeof(ShaderName));
+    table->capacity = capacity;
+    table->count = 0;
+}
+
+static void NameTableDelete(ShaderNameTable* table)
+{
+    for (unsigned int i = 0; i < table->capacity; i++)
+    {
+        free(table->entries[i].name);
+    }
+
+    free(table->entries);
+}
+
+// Returns the entry holding `name`, or the empty slot where it belongs
+static ShaderName* NameTableFind(ShaderNameTable* table, const char* name, uint32_t hash)
+{
+    unsigned int mask = table->capacity - 1;
+    for (unsigned int i = hash & mask;; i = (i + 1) & mask)
+    {
+        ShaderName* entry = &table->entries[i];
+        if (entry->name == NULL || (entry->hash == hash && strcmp(entry->name, name) == 0))
+            return entry;
+    }
+}
+
+static ShaderName* NameTableInsert(ShaderNameTable* table, const char* name, int location)
+{
+    // Keep the table at most half full
+    if (2 * (table->count + 1) > table->capacity)
+    {
+        ShaderNameTable grown;
+        NameTableInitialize(&grown, table->capacity);
+        for (unsigned int i = 0; i < table->capacity; i++)
+        {
+            ShaderName* entry = &table->entries[i];
+            if (entry->name) *NameTableFind(&grown, entry->name, entry->hash) = *entry;
+        }
+
+        grown.count = table->count;
+        free(table->entries);
+        *table = grown;
+    }
+
+    uint32_t hash = HashName(name);
+    ShaderName* entry = NameTableFind(table, name, hash);
+    if (entry->name == NULL)
+    {
+        entry->name = strdup(name);
+        entry->hash = hash;
+        table->count++;
+    }
+
+    entry->location = location;
+    entry->valueKnown = false;
+    return entry;
+}
+
+// Resolves every active uniform and uniform block of a linked program
+static void ResolveNames(ShaderProgram* program)
+{
+    unsigned int programId = program->id;
+
+    int uniformCount, maxLength;
+    GLCall(glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &uniformCount));
+    GLCall(glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+    NameTableInitialize(&program->uniforms, uniformCount);
+
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* name = ArenaAlloc(scratch, maxLength + 1);
+    for (int i = 0; i < uniformCount; i++)
+    {
+        int length, size;
+        GLenum type;
+        GLCall(glGetActiveUniform(programId, i, maxLength + 1, &length, &size, &type, name));
+
+        // Uniforms in blocks have no location
+        GLCall(int location = glGetUniformLocation(programId, name));
+        if (location < 0) continue;
+
+        NameTableInsert(&program->uniforms, name, location);
+
+        // Arrays are listed as name[0] but are usually looked up by name
+        if (length > 3 && strcmp(name + length - 3, "[0]") == 0)
+        {
+            name[length - 3] = '\0';
+            NameTableInsert(&program->uniforms, name, location);
+        }
+    }
+
+    int blockCount;
+    GLCall(glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount));
+    GLCall(glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength));
+    NameTableInitialize(&program->blocks, blockCount);
+
+    name = ArenaAlloc(scratch, maxLength + 1);
+    for (int i = 0; i < blockCount; i++)
+    {
+        GLCall(glGetActiveUniformBlockName(programId, i, maxLength + 1, NULL, name));
+        NameTableInsert(&program->blocks, name, i);
+    }
+
+    ArenaRestore(scratch, mark);
+}
+
+static ShaderProgram* CacheProgram(unsigned int programId)
+{
+    ShaderProgram* program = calloc(1, sizeof(ShaderProgram));
+    program->id = programId;
+    ResolveNames(program);
+
+    program->next = programs;
+    programs = program;
+    return program;
+}
+
+// Returns the cached names of a program, resolving them on first use
+static ShaderProgram* FindProgram(unsigned int programId)
+{
+    if (lastProgram && lastProgram->id == programId) return lastProgram;
+
+    ShaderProgram* program = programs;
+    while (program && program->id != programId) program = program->next;
+
+    lastProgram = program ? program : CacheProgram(programId);
+    return lastProgram;
+}
+
+// Looks up a uniform of a program; names that are not active uniforms,
+// such as array elements, are resolved once by the driver and remembered
+static ShaderName* FindUniform(unsigned int shaderId, const char* name)
+{
+    ShaderProgram* program = FindProgram(shaderId);
+    ShaderName* uniform = NameTableFind(&program->uniforms, name, HashName(name));
+    if (uniform->name) return uniform;
+
+    GLCall(int location = glGetUniformLocation(shaderId, name));
+    return NameTableInsert(&program->uniforms, name, location);
 }
 
 int ShaderGetUniformId(unsigned int shaderId, const char* name)
 {
     // uniform id or index
-    GLCall(int uniformId = glGetUniformLocation(shaderId, name));
-    return uniformId;
+    return FindUniform(shaderId, name)->location;
 }
 
 // Fetches the uniform block index (specific to a shader program)
 int ShaderGetUniformBlockIndex(unsigned int shaderId, const char* name)
 {
-    GLCall(int blockIndex = glGetUniformBlockIndex(shaderId, name));
-    return blockIndex;
+    ShaderProgram* program = FindProgram(shaderId);
+    ShaderName* block = NameTableFind(&program->blocks, name, HashName(name));
+    return block->name ? block->location : (int)GL_INVALID_INDEX;
+}
+
+// Uploads the remembered value of a uniform
+static void UploadUniform(unsigned int shaderId, const ShaderName* uniform)
+{
+    switch (uniform->valueType)
+    {
+        case GL_INT:
+            GLCall(glProgramUniform1iv(shaderId, uniform->location, uniform->valueCount, (const int*)uniform->value));
+            break;
+        case GL_UNSIGNED_INT:
+            GLCall(glProgramUniform1uiv(shaderId, uniform->location, uniform->valueCount, (const unsigned int*)uniform->value));
+            break;
+        case GL_FLOAT:
+            GLCall(glProgramUniform1fv(shaderId, uniform->location, uniform->valueCount, (const float*)uniform->value));
+            break;
+        case GL_FLOAT_VEC2:
+            GLCall(glProgramUniform2fv(shaderId, uniform->location, uniform->valueCount, (const float*)uniform->value));
+            break;
+        default:
+            GLCall(glProgramUniform3fv(shaderId, uniform->location, uniform->valueCount, (const float*)uniform->value));
+            break;
+    }
+}
+
+// Uploads a value of `count` elements of `size` bytes unless the uniform already has it
+// or is not in the program
+static void ChangeUniform(unsigned int shaderId, const char* name, GLenum type, const void* value,
+    unsigned int count, size_t size)
+{
+    if (count * size > ShaderMaxUniformValueSize)
+    {
+        printf("Uniform '%s' is too large to set through the shader module\n", name);
+        return;
+    }
+
+    ShaderName* uniform = FindUniform(shaderId, name);
+    if (uniform->location < 0) return;
+    if (uniform->valueKnown && uniform->valueType == type && uniform->valueCount == count &&
+        memcmp(uniform->value, value, count * size) == 0) return;
+
+    memcpy(uniform->value, value, count * size);
+    uniform->valueKnown = true;
+    uniform->valueType = type;
+    uniform->valueCount = count;
+    UploadUniform(shaderId, uniform);
+}
+
+void ShaderSetInt(unsigned int shaderId, const char* name, int value)
+{
+    ChangeUniform(shaderId, name, GL_INT, &value, 1, sizeof(value));
+}
+
+void ShaderSetFloat(unsigned int shaderId, const char* name, float value)
+{
+    ChangeUniform(shaderId, name, GL_FLOAT, &value, 1, sizeof(value));
+}
+
+void ShaderSetVec2(unsigned int shaderId, const char* name, const float* value)
+{
+    ChangeUniform(shaderId, name, GL_FLOAT_VEC2, value, 1, 2 * sizeof(float));
+}
+
+void ShaderSetVec3(unsigned int shaderId, const char* name, const float* value)
+{
+    ChangeUniform(shaderId, name, GL_FLOAT_VEC3, value, 1, 3 * sizeof(float));
+}
+
+void ShaderSetUInts(unsigned int shaderId, const char* name, const unsigned int* values,
+    unsigned int count)
+{
+    ChangeUniform(shaderId, name, GL_UNSIGNED_INT, values, count, sizeof(unsigned int));
 }
 
 // Binds a uniform binding point with a uniform index within the specified shader program
@@ -59,28 +513,73 @@ void ShaderUniformBlockBinding(unsigned int shaderId, unsigned int blockIndex,
 }
 
 // Binds a uniform buffer to a uniform block located by name in the specified shader program
+// Remembers a block binding so that it can be restored after the program is reloaded
+static void RecordBinding(unsigned int shaderId, const char* name, unsigned int bindingPoint,
+    bool storage)
+{
+    ShaderProgram* program = FindProgram(shaderId);
+    for (unsigned int i = 0; i < program->bindingCount; i++)
+    {
+        ShaderBlockBinding* binding = &program->bindings[i];
+        if (binding->storage == storage && strcmp(binding->name, name) == 0)
+        {
+            binding->bindingPoint = bindingPoint;
+            return;
+        }
+    }
+
+    program->bindings = realloc(program->bindings, (program->bindingCount + 1) * sizeof(ShaderBlockBinding));
+    program->bindings[program->bindingCount++] = (ShaderBlockBinding) { strdup(name), bindingPoint, storage };
+}
+
 void ShaderBindUniformBuffer(unsigned int shaderId, const char* name,
     UniformBuffer* uniformBuffer)
 {
-    GLCall(int blockIndex = glGetUniformBlockIndex(shaderId, name));
+    int blockIndex = ShaderGetUniformBlockIndex(shaderId, name);
     if (blockIndex == GL_INVALID_INDEX) printf("Uniform buffer '%s' was not found\n", name);
     GLCall(glUniformBlockBinding(shaderId, blockIndex, uniformBuffer->bindingPoint));
+    RecordBinding(shaderId, name, uniformBuffer->bindingPoint, false);
 }
 
-unsigned int ShaderCompile(unsigned int type, const char* filePath)
+// Binds a storage binding point with a shader storage block located by name in the specified shader program
+// Blocks given RendererNoBindingPoint are left unbound
+void ShaderBindStorageBlock(unsigned int shaderId, const char* name, unsigned int bindingPoint)
+{
+    if (bindingPoint == RendererNoBindingPoint)
+    {
+        printf("Storage buffer '%s' has no binding point\n", name);
+        return;
+    }
+
+    GLCall(unsigned int blockIndex = glGetProgramResourceIndex(shaderId, GL_SHADER_STORAGE_BLOCK, name));
+    if (blockIndex == GL_INVALID_INDEX) printf("Storage buffer '%s' was not found\n", name);
+    GLCall(glShaderStorageBlockBinding(shaderId, blockIndex, bindingPoint));
+    RecordBinding(shaderId, name, bindingPoint, true);
+}
+
+// Binds a storage buffer to a shader storage block located by name in the specified shader program
+void ShaderBindStorageBuffer(unsigned int shaderId, const char* name,
+    StorageBuffer* storageBuffer)
 {
-    long fileLength = GetFileLength(filePath);
-    char* buffer = malloc(fileLength + 1);
-    ShaderLoad(filePath, buffer);
+    ShaderBindStorageBlock(shaderId, name, storageBuffer->bindingPoint);
+}
 
+// Starts compiling shader source without waiting for the result
+static unsigned int SubmitShader(unsigned int type, const char* source)
+{
     GLCall(unsigned int id = glCreateShader(type));
-    GLCall(glShaderSource(id, 1, (const char* const*)&buffer, NULL));
+    GLCall(glShaderSource(id, 1, &source, NULL));
     GLCall(glCompileShader(id));
+    return id;
+}
 
+// Waits for a submitted shader loaded from filePath
+// Returns 0 and prints the log if compilation failed
+static unsigned int FinishShader(unsigned int id, unsigned int type, const char* filePath)
+{
     int result;
     GLCall(glGetShaderiv(id, GL_COMPILE_STATUS, &result));
 
-    free(buffer);
     if (result != GL_FALSE)
         return id;
 
@@ -88,13 +587,242 @@ unsigned int ShaderCompile(unsigned int type, const char* filePath)
     GLCall(glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length));
     char* message = (char*)alloca(length * sizeof(char));
     GLCall(glGetShaderInfoLog(id, length, NULL, message));
-    printf("Failed to compile %s shader at path '%s'!\n", (type == GL_VERTEX_SHADER) ? "vertex" : "fragment", filePath);
+    const char* typeName = type == GL_VERTEX_SHADER ? "vertex" :
+        type == GL_FRAGMENT_SHADER ? "fragment" : "compute";
+    printf("Failed to compile %s shader at path '%s'!\n", typeName, filePath);
     printf(message);
     printf("%s\n", filePath);
     GLCall(glDeleteShader(id));
     return 0;
 }
 
+// Waits for a submitted link of a program built from `count` files
+// Returns false and prints the log if linking failed
+static bool FinishProgram(unsigned int programId, const char** filePaths, unsigned int count)
+{
+    int result;
+    GLCall(glGetProgramiv(programId, GL_LINK_STATUS, &result));
+
+    if (result != GL_FALSE)
+        return true;
+
+    int length;
+    GLCall(glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &length));
+    char* message = (char*)alloca((length + 1) * sizeof(char));
+    message[0] = '\0';
+    GLCall(glGetProgramInfoLog(programId, length + 1, NULL, message));
+    printf("Failed to link program from");
+    for (unsigned int i = 0; i < count; i++) printf(" '%s'", filePaths[i]);
+    printf("!\n%s\n", message);
+    return false;
+}
+
+// Compiles shader source loaded from filePath
+// Returns 0 and prints the log if compilation fails
+static unsigned int ShaderCompileSource(unsigned int type, const char* source, const char* filePath)
+{
+    return FinishShader(SubmitShader(type, source), type, filePath);
+}
+
+unsigned int ShaderCompile(unsigned int type, const char* filePath)
+{
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* buffer = ShaderLoadSource(scratch, filePath);
+    unsigned int id = ShaderCompileSource(type, buffer, filePath);
+
+    ArenaRestore(scratch, mark);
+    return id;
+}
+
+// Returns the source loaded from filePath with the first occurrence of `marker` replaced
+// by `insert`, allocated from the arena, or NULL if there is no marker
+static char* SpliceTemplate(Arena* arena, const char* buffer, const char* filePath, const char* marker,
+    const char* insert)
+{
+    const char* markerStart = strstr(buffer, marker);
+    if (markerStart == NULL)
+    {
+        printf("Template marker '%s' was not found in '%s'\n", marker, filePath);
+        return NULL;
+    }
+
+    size_t prefixLength = markerStart - buffer;
+    size_t insertLength = strlen(insert);
+    const char* suffix = markerStart + strlen(marker);
+    char* source = ArenaAlloc(arena, prefixLength + insertLength + strlen(suffix) + 1);
+    memcpy(source, buffer, prefixLength);
+    memcpy(source + prefixLength, insert, insertLength);
+    strcpy(source + prefixLength + insertLength, suffix);
+    return source;
+}
+
+// Compiles the shader at filePath with the first occurrence of `marker` replaced by `insert`
+// Lets generated code, such as a user function, be spliced into a shader file
+unsigned int ShaderCompileTemplate(unsigned int type, const char* filePath, const char* marker,
+    const char* insert)
+{
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* buffer = ShaderLoadSource(scratch, filePath);
+    char* source = SpliceTemplate(scratch, buffer, filePath, marker, insert);
+    unsigned int id = source ? ShaderCompileSource(type, source, filePath) : 0;
+
+    ArenaRestore(scratch, mark);
+    return id;
+}
+
+// Returns whether the driver can save and load program binaries
+static bool ProgramBinariesSupported()
+{
+    if (programBinaryFormatCount < 0)
+    {
+        GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &programBinaryFormatCount));
+    }
+
+    return programBinaryFormatCount > 0;
+}
+
+// Hashes the sources of a program together with the driver that will link them (FNV-1a)
+static uint64_t ProgramBinaryKey(const char** sources, int count)
+{
+    const char* driver[] = {
+        (const char*)glGetString(GL_VENDOR),
+        (const char*)glGetString(GL_RENDERER),
+        (const char*)glGetString(GL_VERSION),
+    };
+
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < 3 + count; i++)
+    {
+        const char* text = i < 3 ? driver[i] : sources[i - 3];
+        for (; text && *text; text++)
+        {
+            hash = (hash ^ (unsigned char)*text) * 1099511628211ull;
+        }
+
+        // Separates the strings so that moving text between them changes the hash
+        hash = (hash ^ 0xFF) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static void ProgramBinaryPath(uint64_t key, char* path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx.bin", ShaderCacheDirectory, (unsigned long long)key);
+}
+
+// Creates a program from the cached binary for key
+// Returns 0 if there is none or the driver rejects it
+static unsigned int LoadProgramBinary(uint64_t key)
+{
+    if (!ProgramBinariesSupported()) return 0;
+
+    char path[64];
+    ProgramBinaryPath(key, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return 0;
+
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    fseek(file, 0, SEEK_END);
+    long fileLength = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // The binary must fill the rest of the file, so a truncated or corrupt header
+    // never sizes the allocation
+    ProgramBinaryHeader header;
+    void* binary = NULL;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == ProgramBinaryMagic &&
+        header.length > 0 && header.length == fileLength - (long)sizeof(header);
+    if (valid)
+    {
+        binary = ArenaAlloc(scratch, header.length);
+        valid = fread(binary, 1, header.length, file) == header.length;
+    }
+    fclose(file);
+
+    // The program is rebuilt from source and cached again
+    if (!valid) remove(path);
+
+    unsigned int programId = 0;
+    if (valid)
+    {
+        programId = glCreateProgram();
+        GLCall(glProgramBinary(programId, header.format, binary, header.length));
+
+        int linked;
+        GLCall(glGetProgramiv(programId, GL_LINK_STATUS, &linked));
+        if (linked)
+        {
+            CacheProgram(programId);
+        }
+        else
+        {
+            GLCall(glDeleteProgram(programId));
+            programId = 0;
+        }
+    }
+
+    ArenaRestore(scratch, mark);
+    return programId;
+}
+
+// Writes a linked program to the binary cache under key
+static void SaveProgramBinary(unsigned int programId, uint64_t key)
+{
+    if (!ProgramBinariesSupported()) return;
+
+    int linked, length;
+    GLCall(glGetProgramiv(programId, GL_LINK_STATUS, &linked));
+    GLCall(glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (!linked || length <= 0) return;
+
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    ProgramBinaryHeader header = { ProgramBinaryMagic, 0, (uint32_t)length };
+    void* binary = ArenaAlloc(scratch, length);
+    GLCall(glGetProgramBinary(programId, length, NULL, (GLenum*)&header.format, binary));
+
+    char path[64];
+    ProgramBinaryPath(key, path, sizeof(path));
+    MakeDirectory(ShaderCacheDirectory);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("Could not write program binary '%s'\n", path);
+    }
+    else
+    {
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(binary, 1, length, file);
+        fclose(file);
+    }
+
+    ArenaRestore(scratch, mark);
+}
+
+// Remembers the files a program was built from so that it can be rebuilt when they change
+static void RecordProgramFiles(unsigned int programId, const unsigned int* types,
+    const char** filePaths, unsigned int count)
+{
+    ShaderProgram* program = FindProgram(programId);
+    program->stageCount = count;
+    for (unsigned int stage = 0; stage < count; stage++)
+    {
+        struct stat fileStat;
+        program->types[stage] = types[stage];
+        program->filePaths[stage] = strdup(filePaths[stage]);
+        program->modifiedTimes[stage] = stat(filePaths[stage], &fileStat) == 0 ? fileStat.st_mtime : 0;
+    }
+}
+
 // Creates a shader program with a vertex and fragment shader
 // Deletes the passed in vertex and fragment shader
 // Returns the id of the shader
@@ -102,6 +830,7 @@ unsigned int ShaderCreateFromIds(unsigned int vertexShaderId, unsigned int fragm
 {
     unsigned int programId = glCreateProgram();
 
+    GLCall(glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
     GLCall(glAttachShader(programId, vertexShaderId));
     GLCall(glAttachShader(programId, fragmentShaderId));
     GLCall(glLinkProgram(programId));
@@ -110,18 +839,801 @@ unsigned int ShaderCreateFromIds(unsigned int vertexShaderId, unsigned int fragm
     GLCall(glDeleteShader(vertexShaderId));
     GLCall(glDeleteShader(fragmentShaderId));
 
+    CacheProgram(programId);
     return programId;
 }
 
+// Loads the program from the binary cache when its sources have not changed,
+// otherwise compiles it and adds it to the cache
 unsigned int ShaderCreate(const char* vertexShaderFilePath, const char* fragmentShaderFilePath)
 {
-    unsigned int vertexShaderId = ShaderCompile(GL_VERTEX_SHADER, vertexShaderFilePath);
-    unsigned int fragmentShaderId = ShaderCompile(GL_FRAGMENT_SHADER, fragmentShaderFilePath);
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* sources[] = {
+        ShaderLoadSource(scratch, vertexShaderFilePath),
+        ShaderLoadSource(scratch, fragmentShaderFilePath),
+    };
+    uint64_t key = ProgramBinaryKey((const char**)sources, 2);
+
+    unsigned int programId = LoadProgramBinary(key);
+    if (!programId)
+    {
+        unsigned int vertexShaderId = ShaderCompileSource(GL_VERTEX_SHADER, sources[0], vertexShaderFilePath);
+        unsigned int fragmentShaderId = ShaderCompileSource(GL_FRAGMENT_SHADER, sources[1], fragmentShaderFilePath);
+        programId = ShaderCreateFromIds(vertexShaderId, fragmentShaderId);
+        SaveProgramBinary(programId, key);
+    }
+
+    const unsigned int types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* filePaths[] = { vertexShaderFilePath, fragmentShaderFilePath };
+    RecordProgramFiles(programId, types, filePaths, 2);
+
+    ArenaRestore(scratch, mark);
+    return programId;
+}
+
+// Creates a program like ShaderCreate with the vertex shader spliced like ShaderCompileTemplate
+// Returns 0 if the vertex shader has no marker or does not compile
+unsigned int ShaderCreateTemplate(const char* vertexShaderFilePath, const char* fragmentShaderFilePath,
+    const char* marker, const char* insert)
+{
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* vertexFile = ShaderLoadSource(scratch, vertexShaderFilePath);
+    char* sources[] = {
+        SpliceTemplate(scratch, vertexFile, vertexShaderFilePath, marker, insert),
+        ShaderLoadSource(scratch, fragmentShaderFilePath),
+    };
+
+    unsigned int programId = 0;
+    if (sources[0])
+    {
+        uint64_t key = ProgramBinaryKey((const char**)sources, 2);
+        programId = LoadProgramBinary(key);
+        if (!programId)
+        {
+            unsigned int vertexShaderId = ShaderCompileSource(GL_VERTEX_SHADER, sources[0], vertexShaderFilePath);
+            if (vertexShaderId)
+            {
+                unsigned int fragmentShaderId = ShaderCompileSource(GL_FRAGMENT_SHADER, sources[1], fragmentShaderFilePath);
+                programId = ShaderCreateFromIds(vertexShaderId, fragmentShaderId);
+                SaveProgramBinary(programId, key);
+            }
+        }
+    }
+
+    if (programId)
+    {
+        const unsigned int types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+        const char* filePaths[] = { vertexShaderFilePath, fragmentShaderFilePath };
+        RecordProgramFiles(programId, types, filePaths, 2);
+
+        ShaderProgram* program = FindProgram(programId);
+        program->templateMarker = strdup(marker);
+        program->templateInsert = strdup(insert);
+    }
+
+    ArenaRestore(scratch, mark);
+    return programId;
+}
+
+// Creates a shader program with a single compute shader, using the binary cache like ShaderCreate
+unsigned int ShaderCreateCompute(const char* computeShaderFilePath)
+{
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* source = ShaderLoadSource(scratch, computeShaderFilePath);
+    uint64_t key = ProgramBinaryKey((const char**)&source, 1);
+
+    unsigned int programId = LoadProgramBinary(key);
+    if (!programId)
+    {
+        unsigned int computeShaderId = ShaderCompileSource(GL_COMPUTE_SHADER, source, computeShaderFilePath);
+        programId = glCreateProgram();
+
+        GLCall(glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+        GLCall(glAttachShader(programId, computeShaderId));
+        GLCall(glLinkProgram(programId));
+        GLCall(glValidateProgram(programId));
+
+        GLCall(glDeleteShader(computeShaderId));
+
+        CacheProgram(programId);
+        SaveProgramBinary(programId, key);
+    }
+
+    const unsigned int type = GL_COMPUTE_SHADER;
+    RecordProgramFiles(programId, &type, &computeShaderFilePath, 1);
+
+    ArenaRestore(scratch, mark);
+    return programId;
+}
+
+// A shader file read by ShaderCreateBatch
+typedef struct BatchFile
+{
+    const char* filePath;
+    char* source;
+    long capacity; // Bytes allocated for the source
+} BatchFile;
+
+// The files and shaders of one program in a batch
+typedef struct BatchProgram
+{
+    unsigned int types[2];
+    unsigned int files[2];
+    unsigned int shaderIds[2];
+    unsigned int stageCount;
+    uint64_t key;
+    bool pending; // Compiled from source and not yet checked
+} BatchProgram;
+
+// Reads files into buffers the calling thread allocated from its scratch arena
+static void LoadBatchFiles(unsigned int start, unsigned int end, void* context)
+{
+    BatchFile* files = context;
+    for (unsigned int i = start; i < end; i++)
+    {
+        ShaderLoad(files[i].filePath, files[i].source, files[i].capacity);
+    }
+}
+
+// Returns the index of filePath in files, adding it if it is new
+static unsigned int AddBatchFile(BatchFile* files, unsigned int* fileCount, const char* filePath)
+{
+    for (unsigned int i = 0; i < *fileCount; i++)
+    {
+        if (strcmp(files[i].filePath, filePath) == 0) return i;
+    }
+
+    files[*fileCount].filePath = filePath;
+    return (*fileCount)++;
+}
+
+void ShaderCreateBatch(ShaderProgramRequest* requests, unsigned int count)
+{
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    BatchFile* files = ArenaAlloc(scratch, 2 * count * sizeof(BatchFile));
+    BatchProgram* batch = ArenaAlloc(scratch, count * sizeof(BatchProgram));
+    memset(batch, 0, count * sizeof(BatchProgram));
+    unsigned int fileCount = 0;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        BatchProgram* program = &batch[i];
+        if (requests[i].computeShaderFilePath)
+        {
+            program->types[0] = GL_COMPUTE_SHADER;
+            program->files[0] = AddBatchFile(files, &fileCount, requests[i].computeShaderFilePath);
+            program->stageCount = 1;
+        }
+        else
+        {
+            program->types[0] = GL_VERTEX_SHADER;
+            program->types[1] = GL_FRAGMENT_SHADER;
+            program->files[0] = AddBatchFile(files, &fileCount, requests[i].vertexShaderFilePath);
+            program->files[1] = AddBatchFile(files, &fileCount, requests[i].fragmentShaderFilePath);
+            program->stageCount = 2;
+        }
+    }
+
+    // Each file is read once, across threads; includes are expanded afterwards since the
+    // expansions are allocated from this thread's arena
+    for (unsigned int i = 0; i < fileCount; i++)
+    {
+        files[i].capacity = GetFileLength(files[i].filePath) + 1;
+        files[i].source = ArenaAlloc(scratch, files[i].capacity);
+    }
+
+    ParallelFor(fileCount, 1, LoadBatchFiles, files);
+
+    for (unsigned int i = 0; i < fileCount; i++)
+    {
+        files[i].source = ExpandIncludes(scratch, files[i].source, files[i].filePath);
+    }
+
+    bool parallelCompile = GLEW_KHR_parallel_shader_compile;
+    if (parallelCompile)
+    {
+        GLCall(glMaxShaderCompilerThreadsKHR(0xFFFFFFFF));
+    }
+
+    // Submit every compile and link before asking for any result
+    for (unsigned int i = 0; i < count; i++)
+    {
+        BatchProgram* program = &batch[i];
+        const char* sources[2];
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            sources[stage] = files[program->files[stage]].source;
+        }
+
+        program->key = ProgramBinaryKey(sources, program->stageCount);
+        requests[i].programId = LoadProgramBinary(program->key);
+        if (requests[i].programId) continue;
+
+        unsigned int programId = glCreateProgram();
+        GLCall(glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            program->shaderIds[stage] = SubmitShader(program->types[stage], sources[stage]);
+            GLCall(glAttachShader(programId, program->shaderIds[stage]));
+        }
+        GLCall(glLinkProgram(programId));
+
+        requests[i].programId = programId;
+        program->pending = true;
+    }
+
+    // Without the extension the queries below block on each program in turn
+    bool waiting = parallelCompile;
+    while (waiting)
+    {
+        waiting = false;
+        for (unsigned int i = 0; i < count && !waiting; i++)
+        {
+            int complete = GL_TRUE;
+            if (batch[i].pending)
+            {
+                GLCall(glGetProgramiv(requests[i].programId, GL_COMPLETION_STATUS_KHR, &complete));
+            }
+            waiting = !complete;
+        }
+
+        if (waiting) sched_yield();
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        BatchProgram* program = &batch[i];
+        const char* filePaths[2];
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            filePaths[stage] = files[program->files[stage]].filePath;
+        }
+
+        if (program->pending)
+        {
+            // FinishShader deletes shaders that failed; the others are freed with the program
+            unsigned int programId = requests[i].programId;
+            bool compiled = true;
+            for (unsigned int stage = 0; stage < program->stageCount; stage++)
+            {
+                unsigned int shaderId = program->shaderIds[stage];
+                if (FinishShader(shaderId, program->types[stage], filePaths[stage]))
+                {
+                    GLCall(glDeleteShader(shaderId));
+                }
+                else
+                {
+                    compiled = false;
+                }
+            }
+
+            if (!compiled || !FinishProgram(programId, filePaths, program->stageCount))
+            {
+                GLCall(glDeleteProgram(programId));
+                requests[i].programId = 0;
+                continue;
+            }
+
+            GLCall(glValidateProgram(programId));
+            CacheProgram(programId);
+            SaveProgramBinary(programId, program->key);
+        }
+
+        RecordProgramFiles(requests[i].programId, program->types, filePaths, program->stageCount);
+    }
+
+    ArenaRestore(scratch, mark);
+}
+
+// Deletes a rebuild that has not been swapped in
+static void AbandonRebuild(ShaderProgram* program)
+{
+    ShaderBuild* build = program->build;
+    if (build)
+    {
+        program->build = NULL;
+
+        pthread_mutex_lock(&buildMutex);
+        bool complete = atomic_load(&build->complete);
+        build->abandoned = !complete;
+        pthread_mutex_unlock(&buildMutex);
+
+        if (!complete) return;
+
+        program->rebuildId = build->programId;
+        memcpy(program->rebuildShaderIds, build->shaderIds, sizeof(build->shaderIds));
+        free(build);
+    }
+
+    if (!program->rebuildId) return;
+
+    for (unsigned int stage = 0; stage < program->stageCount; stage++)
+    {
+        GLCall(glDeleteShader(program->rebuildShaderIds[stage]));
+    }
+
+    GLCall(glDeleteProgram(program->rebuildId));
+    program->rebuildId = 0;
+}
+
+// Submits a new build of a program from its files without waiting for it
+static void StartRebuild(ShaderProgram* program)
+{
+    AbandonRebuild(program);
+
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    char* sources[2];
+    bool spliced = true;
+    for (unsigned int stage = 0; stage < program->stageCount; stage++)
+    {
+        sources[stage] = ShaderLoadSource(scratch, program->filePaths[stage]);
+        if (program->templateMarker && program->types[stage] == GL_VERTEX_SHADER)
+        {
+            sources[stage] = SpliceTemplate(scratch, sources[stage], program->filePaths[stage],
+                program->templateMarker, program->templateInsert);
+            spliced = sources[stage] != NULL;
+        }
+    }
+
+    if (!spliced)
+    {
+        ArenaRestore(scratch, mark);
+        printf("Keeping the previous build of program %u\n", program->id);
+        return;
+    }
+
+    program->rebuildKey = ProgramBinaryKey((const char**)sources, program->stageCount);
+
+    if (rebuildContext)
+    {
+        ShaderBuild* build = calloc(1, sizeof(ShaderBuild));
+        build->stageCount = program->stageCount;
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            build->types[stage] = program->types[stage];
+            build->sources[stage] = strdup(sources[stage]);
+        }
+
+        program->build = build;
+        ArenaRestore(scratch, mark);
+
+        pthread_mutex_lock(&buildMutex);
+        build->next = buildQueue;
+        buildQueue = build;
+        pthread_cond_signal(&buildQueued);
+        pthread_mutex_unlock(&buildMutex);
+        return;
+    }
+
+    program->rebuildId = glCreateProgram();
+    GLCall(glProgramParameteri(program->rebuildId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+
+    for (unsigned int stage = 0; stage < program->stageCount; stage++)
+    {
+        program->rebuildShaderIds[stage] = SubmitShader(program->types[stage], sources[stage]);
+        GLCall(glAttachShader(program->rebuildId, program->rebuildShaderIds[stage]));
+    }
+
+    GLCall(glLinkProgram(program->rebuildId));
+    ArenaRestore(scratch, mark);
+}
+
+// Replaces the executable of a program with that of its linked rebuild, keeping the program id
+// The binary is copied when the driver supports it; otherwise the program is relinked
+// from the rebuilt shaders, which are known to link
+static void SwapRebuild(ShaderProgram* program)
+{
+    int linked = GL_FALSE;
+    if (ProgramBinariesSupported())
+    {
+        int length;
+        GLCall(glGetProgramiv(program->rebuildId, GL_PROGRAM_BINARY_LENGTH, &length));
+        if (length > 0)
+        {
+            Arena* scratch = ArenaScratch();
+            ArenaMark mark = ArenaSave(scratch);
+
+            GLenum format;
+            void* binary = ArenaAlloc(scratch, length);
+            GLCall(glGetProgramBinary(program->rebuildId, length, NULL, &format, binary));
+            GLCall(glProgramBinary(program->id, format, binary, length));
+            GLCall(glGetProgramiv(program->id, GL_LINK_STATUS, &linked));
+            ArenaRestore(scratch, mark);
+        }
+    }
+
+    if (!linked)
+    {
+        unsigned int attached[2];
+        int attachedCount;
+        GLCall(glGetAttachedShaders(program->id, 2, &attachedCount, attached));
+        for (int i = 0; i < attachedCount; i++)
+        {
+            GLCall(glDetachShader(program->id, attached[i]));
+        }
+
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            GLCall(glAttachShader(program->id, program->rebuildShaderIds[stage]));
+        }
+
+        GLCall(glLinkProgram(program->id));
+    }
+
+    // Locations may have moved and block bindings and uniform values were reset
+    ShaderNameTable uniforms = program->uniforms;
+    NameTableDelete(&program->blocks);
+    ResolveNames(program);
+
+    for (unsigned int i = 0; i < uniforms.capacity; i++)
+    {
+        ShaderName* previous = &uniforms.entries[i];
+        if (!previous->name || !previous->valueKnown) continue;
+
+        ShaderName* uniform = FindUniform(program->id, previous->name);
+        if (uniform->location < 0) continue;
+
+        memcpy(uniform->value, previous->value, sizeof(uniform->value));
+        uniform->valueKnown = true;
+        uniform->valueType = previous->valueType;
+        uniform->valueCount = previous->valueCount;
+        UploadUniform(program->id, uniform);
+    }
+
+    NameTableDelete(&uniforms);
+
+    for (unsigned int i = 0; i < program->bindingCount; i++)
+    {
+        ShaderBlockBinding* binding = &program->bindings[i];
+        if (binding->storage)
+        {
+            GLCall(unsigned int blockIndex = glGetProgramResourceIndex(program->id, GL_SHADER_STORAGE_BLOCK, binding->name));
+            if (blockIndex != GL_INVALID_INDEX)
+            {
+                GLCall(glShaderStorageBlockBinding(program->id, blockIndex, binding->bindingPoint));
+            }
+        }
+        else
+        {
+            int blockIndex = ShaderGetUniformBlockIndex(program->id, binding->name);
+            if (blockIndex != GL_INVALID_INDEX)
+            {
+                GLCall(glUniformBlockBinding(program->id, blockIndex, binding->bindingPoint));
+            }
+        }
+    }
+
+    SaveProgramBinary(program->id, program->rebuildKey);
+}
+
+// Checks a finished rebuild and swaps it in if it compiled and linked
+static void FinishRebuild(ShaderProgram* program)
+{
+    bool compiled = true;
+    for (unsigned int stage = 0; stage < program->stageCount; stage++)
+    {
+        // Failed shaders are deleted by FinishShader
+        unsigned int shaderId = program->rebuildShaderIds[stage];
+        program->rebuildShaderIds[stage] = FinishShader(shaderId, program->types[stage], program->filePaths[stage]);
+        compiled = compiled && program->rebuildShaderIds[stage];
+    }
+
+    int linked = GL_FALSE;
+    if (compiled)
+    {
+        GLCall(glGetProgramiv(program->rebuildId, GL_LINK_STATUS, &linked));
+    }
+
+    if (linked)
+    {
+        SwapRebuild(program);
+        printf("Reloaded program %u from '%s'\n", program->id, program->filePaths[0]);
+    }
+    else
+    {
+        if (compiled)
+        {
+            char message[1024];
+            GLCall(glGetProgramInfoLog(program->rebuildId, sizeof(message), NULL, message));
+            printf("Failed to link program from '%s'!\n%s\n", program->filePaths[0], message);
+        }
+
+        printf("Keeping the previous build of program %u\n", program->id);
+    }
+
+    for (unsigned int stage = 0; stage < program->stageCount; stage++)
+    {
+        if (program->rebuildShaderIds[stage])
+        {
+            GLCall(glDeleteShader(program->rebuildShaderIds[stage]));
+        }
+    }
+
+    GLCall(glDeleteProgram(program->rebuildId));
+    program->rebuildId = 0;
+}
+
+// Starts rebuilding every program that uses the file
+static void ReloadFile(const char* filePath)
+{
+    for (ShaderProgram* program = programs; program; program = program->next)
+    {
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            if (strcmp(program->filePaths[stage], filePath) == 0)
+            {
+                StartRebuild(program);
+                break;
+            }
+        }
+    }
+}
+
+// Starts rebuilding programs whose files were modified since they were last built
+static void PollModifiedFiles()
+{
+    for (ShaderProgram* program = programs; program; program = program->next)
+    {
+        bool modified = false;
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            struct stat fileStat;
+            if (stat(program->filePaths[stage], &fileStat) == 0 &&
+                fileStat.st_mtime != program->modifiedTimes[stage])
+            {
+                program->modifiedTimes[stage] = fileStat.st_mtime;
+                modified = true;
+            }
+        }
 
-    return ShaderCreateFromIds(vertexShaderId, fragmentShaderId);
+        if (modified) StartRebuild(program);
+    }
+}
+
+// Starts rebuilding programs whose files were written since the last call
+static void CheckWatchedFiles()
+{
+#ifdef __linux__
+    if (inotifyFd >= 0)
+    {
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(inotifyFd, events, sizeof(events))) > 0)
+        {
+            for (char* e = events; e < events + length; e += sizeof(struct inotify_event) + ((struct inotify_event*)e)->len)
+            {
+                struct inotify_event* event = (struct inotify_event*)e;
+                if (event->len == 0) continue;
+
+                char filePath[512];
+                snprintf(filePath, sizeof(filePath), "%s/%s", watchedDirectory, event->name);
+                ReloadFile(filePath);
+            }
+        }
+        return;
+    }
+#endif
+
+    if (pollCountdown-- > 0) return;
+    pollCountdown = ShaderPollInterval;
+    PollModifiedFiles();
+}
+
+// Deletes the objects of an abandoned build
+static void DeleteBuild(ShaderBuild* build)
+{
+    for (unsigned int stage = 0; stage < build->stageCount; stage++)
+    {
+        GLCall(glDeleteShader(build->shaderIds[stage]));
+    }
+
+    GLCall(glDeleteProgram(build->programId));
+    free(build);
+}
+
+// Compiles and links queued builds on the rebuild context, waiting for each to finish
+// so that the main thread only ever sees complete programs
+static void* RunBuilds(void* context)
+{
+    glfwMakeContextCurrent(rebuildContext);
+
+    pthread_mutex_lock(&buildMutex);
+    while (!stopBuilding)
+    {
+        ShaderBuild* build = buildQueue;
+        if (!build)
+        {
+            pthread_cond_wait(&buildQueued, &buildMutex);
+            continue;
+        }
+
+        buildQueue = build->next;
+        pthread_mutex_unlock(&buildMutex);
+
+        build->programId = glCreateProgram();
+        GLCall(glProgramParameteri(build->programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+        for (unsigned int stage = 0; stage < build->stageCount; stage++)
+        {
+            build->shaderIds[stage] = SubmitShader(build->types[stage], build->sources[stage]);
+            GLCall(glAttachShader(build->programId, build->shaderIds[stage]));
+            free(build->sources[stage]);
+        }
+
+        GLCall(glLinkProgram(build->programId));
+
+        int linked;
+        GLCall(glGetProgramiv(build->programId, GL_LINK_STATUS, &linked));
+        GLCall(glFinish());
+
+        pthread_mutex_lock(&buildMutex);
+        if (build->abandoned)
+        {
+            DeleteBuild(build);
+        }
+        else
+        {
+            atomic_store(&build->complete, true);
+        }
+    }
+    pthread_mutex_unlock(&buildMutex);
+
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+void ShaderWatchDirectory(const char* directory, GLFWwindow* context)
+{
+    free(watchedDirectory);
+    watchedDirectory = strdup(directory);
+    parallelRebuilds = GLEW_KHR_parallel_shader_compile;
+    pollCountdown = 0;
+
+    if (!parallelRebuilds && context && !rebuildContext)
+    {
+        rebuildContext = context;
+        stopBuilding = false;
+        if (pthread_create(&rebuildThread, NULL, RunBuilds, NULL) != 0) rebuildContext = NULL;
+    }
+
+#ifdef __linux__
+    if (inotifyFd < 0) inotifyFd = inotify_init1(IN_NONBLOCK);
+    if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+}
+
+void ShaderUpdateReloads()
+{
+    if (!watchedDirectory) return;
+
+    CheckWatchedFiles();
+
+    for (ShaderProgram* program = programs; program; program = program->next)
+    {
+        ShaderBuild* build = program->build;
+        if (build)
+        {
+            if (!atomic_load(&build->complete)) continue;
+
+            program->build = NULL;
+            program->rebuildId = build->programId;
+            memcpy(program->rebuildShaderIds, build->shaderIds, sizeof(build->shaderIds));
+            free(build);
+            FinishRebuild(program);
+            continue;
+        }
+
+        if (!program->rebuildId) continue;
+
+        if (parallelRebuilds)
+        {
+            int complete;
+            GLCall(glGetProgramiv(program->rebuildId, GL_COMPLETION_STATUS_KHR, &complete));
+            if (!complete) continue;
+        }
+
+        FinishRebuild(program);
+    }
+}
+
+void ShaderStopWatching()
+{
+    if (rebuildContext)
+    {
+        pthread_mutex_lock(&buildMutex);
+        stopBuilding = true;
+        pthread_cond_signal(&buildQueued);
+        pthread_mutex_unlock(&buildMutex);
+        pthread_join(rebuildThread, NULL);
+        rebuildContext = NULL;
+
+        // Builds the thread did not start have no objects to delete
+        while (buildQueue)
+        {
+            ShaderBuild* build = buildQueue;
+            buildQueue = build->next;
+            for (unsigned int stage = 0; stage < build->stageCount; stage++)
+            {
+                free(build->sources[stage]);
+            }
+
+            if (build->abandoned)
+            {
+                free(build);
+            }
+            else
+            {
+                atomic_store(&build->complete, true);
+            }
+        }
+    }
+
+    for (ShaderProgram* program = programs; program; program = program->next)
+    {
+        AbandonRebuild(program);
+    }
+
+    free(watchedDirectory);
+    watchedDirectory = NULL;
+
+#ifdef __linux__
+    if (inotifyFd >= 0)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
 }
 
 void ShaderUse(unsigned int shaderId)
 {
-    GLCall(glUseProgram(shaderId));
+    RendererUseProgram(shaderId);
+}
+
+void ShaderDelete(unsigned int shaderId)
+{
+    ShaderProgram** link = &programs;
+    while (*link && (*link)->id != shaderId) link = &(*link)->next;
+
+    ShaderProgram* program = *link;
+    if (program)
+    {
+        *link = program->next;
+        AbandonRebuild(program);
+        NameTableDelete(&program->uniforms);
+        NameTableDelete(&program->blocks);
+
+        for (unsigned int stage = 0; stage < program->stageCount; stage++)
+        {
+            free(program->filePaths[stage]);
+        }
+
+        free(program->templateMarker);
+        free(program->templateInsert);
+
+        for (unsigned int i = 0; i < program->bindingCount; i++)
+        {
+            free(program->bindings[i].name);
+        }
+
+        free(program->bindings);
+        free(program);
+    }
+
+    if (lastProgram == program) lastProgram = NULL;
+
+    GLCall(glDeleteProgram(shaderId));
 }
\ No newline at end of file
@@ -1,12 +1,75 @@
 #pragma once
 
+#include <GLFW\glfw3.h>
 #include "renderer.h"
 
 void ShaderUse(unsigned int shaderId);
 int ShaderGetUniformId(unsigned int shaderId, const char* name);
 int ShaderGetUniformBlockIndex(unsigned int shaderId, const char* name);
+
+// Set uniforms through cached locations; a value equal to the last one set is not uploaded
+// Values are set again when a program is reloaded. Uniforms set directly with glUniform
+// are not seen by the cache and are reset by a reload
+void ShaderSetInt(unsigned int shaderId, const char* name, int value);
+void ShaderSetFloat(unsigned int shaderId, const char* name, float value);
+void ShaderSetVec2(unsigned int shaderId, const char* name, const float* value);
+void ShaderSetVec3(unsigned int shaderId, const char* name, const float* value);
+
+// The largest uniform value the cache remembers, such as an array of eight uints
+#define ShaderMaxUniformValueSize 32
+
+// Sets a uint array uniform of at most ShaderMaxUniformValueSize bytes
+void ShaderSetUInts(unsigned int shaderId, const char* name, const unsigned int* values,
+    unsigned int count);
+
 void ShaderBindUniformBuffer(unsigned int shaderId, const char* name,
     UniformBuffer* uniformBuffer);
+void ShaderBindStorageBlock(unsigned int shaderId, const char* name, unsigned int bindingPoint);
+void ShaderBindStorageBuffer(unsigned int shaderId, const char* name,
+    StorageBuffer* storageBuffer);
 unsigned int ShaderCompile(unsigned int type, const char* filePath);
+unsigned int ShaderCompileTemplate(unsigned int type, const char* filePath, const char* marker,
+    const char* insert);
 unsigned int ShaderCreateFromIds(unsigned int vertexShaderId, unsigned int fragmentShaderId);
-unsigned int ShaderCreate(const char* vertexShaderFilePath, const char* fragmentShaderFilePath);
\ No newline at end of file
+unsigned int ShaderCreate(const char* vertexShaderFilePath, const char* fragmentShaderFilePath);
+unsigned int ShaderCreateTemplate(const char* vertexShaderFilePath, const char* fragmentShaderFilePath,
+    const char* marker, const char* insert);
+unsigned int ShaderCreateCompute(const char* computeShaderFilePath);
+
+// A program for ShaderCreateBatch: a vertex and fragment shader, or a compute shader
+typedef struct ShaderProgramRequest
+{
+    const char* vertexShaderFilePath;
+    const char* fragmentShaderFilePath;
+    const char* computeShaderFilePath; // NULL unless this is a compute program
+    unsigned int programId; // Set by ShaderCreateBatch; 0 if the program failed to build
+} ShaderProgramRequest;
+
+// Creates several programs at once, like ShaderCreate and ShaderCreateCompute
+// The files are read concurrently, and every compile and link is submitted before any
+// result is read so that drivers with GL_KHR_parallel_shader_compile build them in parallel
+// Compile and link errors are printed
+void ShaderCreateBatch(ShaderProgramRequest* requests, unsigned int count);
+
+// Provides the source substituted for `#include "name"` lines in shader files,
+// such as declarations generated from C structs; the source is not copied
+void ShaderDefineInclude(const char* name, const char* source);
+
+// Watches a directory of shader files; programs built from files that change are rebuilt
+// and replace the old build in place, keeping their ids and block bindings
+// A build that fails to compile or link is reported and the old one is kept
+// Without GL_KHR_parallel_shader_compile, rebuilds are compiled on a thread that makes
+// `context` current; it must share objects with the main context. If it is NULL,
+// rebuilds are compiled on the main thread
+void ShaderWatchDirectory(const char* directory, GLFWwindow* context);
+
+// Starts rebuilding programs with changed files and swaps in finished rebuilds
+// Called once per frame; it never waits for the compiler unless ShaderWatchDirectory
+// was given no context on a driver without GL_KHR_parallel_shader_compile
+void ShaderUpdateReloads();
+
+// Stops watching for changes and abandons rebuilds in progress, releasing the context
+// given to ShaderWatchDirectory
+void ShaderStopWatching();
+
+void ShaderDelete(unsigned int shaderId);
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+// Four-wide float math for SSE2, used by loops that evaluate functions over grids
+// Errors are around 1e-7 relative for Exp4 and 1e-5 absolute for Sin4 with |x| < 200
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+// e^x
+static inline __m128 Exp4(__m128 x)
+{
+    x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+    x = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+
+    // x = n * ln(2) + r, with n = round(x / ln(2))
+    __m128 n = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f))));
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+
+    // e^r on [-ln(2) / 2, ln(2) / 2]
+    __m128 y = _mm_set1_ps(1.9875691500e-4f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+
+    // 2^n built directly in the exponent bits
+    __m128i exponent = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+    return _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(exponent, 23)));
+}
+
+// sin(x)
+static inline __m128 Sin4(__m128 x)
+{
+    const __m128 pi = _mm_set1_ps(3.14159265358979f);
+
+    // Reduce to [-pi, pi]
+    __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.159154943091895f))));
+    x = _mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(6.28318530717959f)));
+
+    // Reflect into [-pi / 2, pi / 2] using sin(x) = sin(pi - x)
+    __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.0f));
+    __m128 absX = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    __m128 reflected = _mm_sub_ps(pi, absX);
+    absX = _mm_min_ps(absX, reflected);
+    x = _mm_or_ps(absX, sign);
+
+    // Taylor series to x^9; error below 4e-6 on [-pi / 2, pi / 2]
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(2.75573192e-6f);
+    y = _mm_add_ps(_mm_mul_ps(y, x2), _mm_set1_ps(-1.98412698e-4f));
+    y = _mm_add_ps(_mm_mul_ps(y, x2), _mm_set1_ps(8.33333333e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x2), _mm_set1_ps(-1.66666667e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x2), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(y, x);
+}
+#endif
\ No newline at end of file
@@ -2,20 +2,333 @@
 #include <GL\glew.h>
 #include <GLFW\glfw3.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
 #include "input.h"
 #include "debug.h"
 #include "polygon.h"
 #include "camera.h"
+#include "renderer.h"
+#include "shader.h"
+#include "timer.h"
+#include "capture.h"
+#include "benchmark.h"
+#include "triple_buffer.h"
+#include "job.h"
+#include "arena.h"
+#include "simulation.h"
 
 GLFWwindow* Initialize();
 void Update(float deltaTime);
 void Render(float deltaTime);
+void Step(const void* previous, void* next, double time, double timeStep);
+
+static SimOptions options = { false, false, 0, 60.0, NULL, 0, 21, NULL, PolygonCullCPU, false };
+static unsigned long simFrame;
+
+// The world is advanced by Step on its own thread and passed to frames through a triple
+// buffer of snapshots; each snapshot holds two consecutive states for interpolation
+typedef struct SimSnapshot
+{
+    unsigned long step; // The index of the newer state, which is at time step / SimStepRate
+} SimSnapshot;
+
+// States follow the snapshot header at this alignment
+#define SimStateAlignment 16
+
+static void* initialWorld;
+static size_t worldSize;
+static size_t worldStride;
+static TripleBuffer snapshots;
+static pthread_t stepThread;
+static bool isStepping;
+
+// Steps are paced by the clock, or by the frames when time advances by a fixed step
+static pthread_mutex_t stepMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stepChanged = PTHREAD_COND_INITIALIZER;
+static unsigned long requestedStep;
+static unsigned long publishedStep;
+static bool stopStepping;
+static double stepStartTime;
+
+static const void* framePrevious;
+static const void* frameCurrent;
+static float frameAlpha;
+
+const SimOptions* SimGetOptions()
+{
+    return &options;
+}
+
+// Headless and benchmark frames advance the simulation by a fixed step so that
+// recordings play back at the frame rate regardless of how fast they were rendered,
+// and every run of a benchmark renders the same frames
+double SimGetTime()
+{
+    if (options.headless || options.benchmark) return simFrame / options.frameRate;
+    return glfwGetTime();
+}
+
+void SimInitializeWorld(const void* world, size_t size)
+{
+    free(initialWorld);
+    initialWorld = malloc(size);
+    memcpy(initialWorld, world, size);
+    worldSize = size;
+    worldStride = (size + SimStateAlignment - 1) / SimStateAlignment * SimStateAlignment;
+}
+
+void SimGetWorld(const void** previous, const void** current, float* alpha)
+{
+    *previous = framePrevious;
+    *current = frameCurrent;
+    *alpha = frameAlpha;
+}
+
+static bool IsFixedStep()
+{
+    return options.headless || options.benchmark;
+}
+
+// The state with index 0 is the previous state of the snapshot
+static void* SnapshotState(const SimSnapshot* snapshot, int index)
+{
+    return (char*)snapshot + SimStateAlignment + index * worldStride;
+}
+
+// Returns the first step at or after `time`, which frames at that time interpolate towards
+static unsigned long StepAt(double time)
+{
+    return time > 0.0 ? (unsigned long)ceil(time * SimStepRate) : 0;
+}
+
+// Waits on stepChanged until `time` on the glfw clock; stepMutex must be held
+static void WaitUntil(double time)
+{
+    double seconds = time - glfwGetTime();
+    if (seconds <= 0.0) return;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long nanoseconds = deadline.tv_nsec + (long long)(seconds * 1e9);
+    deadline.tv_sec += nanoseconds / 1000000000;
+    deadline.tv_nsec = nanoseconds % 1000000000;
+    pthread_cond_timedwait(&stepChanged, &stepMutex, &deadline);
+}
+
+// Steps the world one step ahead of the clock, or up to the step the frames requested,
+// publishing a snapshot after every step
+static void* RunSteps(void* arg)
+{
+    TimerTraceNameThread("Simulation");
+
+    char* states = malloc(2 * worldStride);
+    memcpy(states, initialWorld, worldSize);
+    unsigned long step = 0;
+
+    pthread_mutex_lock(&stepMutex);
+    while (!stopStepping)
+    {
+        unsigned long target = IsFixedStep() ? requestedStep : StepAt(glfwGetTime() - stepStartTime);
+        if (step >= target)
+        {
+            if (IsFixedStep()) pthread_cond_wait(&stepChanged, &stepMutex);
+            else WaitUntil(stepStartTime + step / SimStepRate);
+            continue;
+        }
+
+        pthread_mutex_unlock(&stepMutex);
+
+        const void* previous = states + (step % 2) * worldStride;
+        void* next = states + ((step + 1) % 2) * worldStride;
+
+        TimerTraceBegin("Step");
+        Step(previous, next, (step + 1) / SimStepRate, 1.0 / SimStepRate);
+        TimerTraceEnd();
+        step++;
+
+        SimSnapshot* snapshot = TripleBufferWriteBuffer(&snapshots);
+        snapshot->step = step;
+        memcpy(SnapshotState(snapshot, 0), previous, worldSize);
+        memcpy(SnapshotState(snapshot, 1), next, worldSize);
+        TripleBufferPublish(&snapshots);
+
+        pthread_mutex_lock(&stepMutex);
+        publishedStep = step;
+        pthread_cond_broadcast(&stepChanged);
+    }
+    pthread_mutex_unlock(&stepMutex);
+
+    free(states);
+    return NULL;
+}
+
+// Starts stepping the world given to SimInitializeWorld from the current time
+// Returns false if the simulation thread could not be started
+static bool StartStepping()
+{
+    if (!initialWorld) return true;
+
+    size_t snapshotSize = SimStateAlignment + 2 * worldStride;
+    SimSnapshot* initial = calloc(1, snapshotSize);
+    memcpy(SnapshotState(initial, 0), initialWorld, worldSize);
+    memcpy(SnapshotState(initial, 1), initialWorld, worldSize);
+    TripleBufferInitialize(&snapshots, snapshotSize, initial);
+    free(initial);
+
+    stepStartTime = SimGetTime();
+    isStepping = pthread_create(&stepThread, NULL, RunSteps, NULL) == 0;
+    if (!isStepping)
+    {
+        printf("Failed to start the simulation thread!\n");
+        TripleBufferDelete(&snapshots);
+    }
+
+    return isStepping;
+}
+
+static void StopStepping()
+{
+    if (!isStepping) return;
+
+    pthread_mutex_lock(&stepMutex);
+    stopStepping = true;
+    pthread_cond_broadcast(&stepChanged);
+    pthread_mutex_unlock(&stepMutex);
+
+    pthread_join(stepThread, NULL);
+    TripleBufferDelete(&snapshots);
+    isStepping = false;
+}
+
+// Takes the newest snapshot for a frame at `time`, first waiting for the step the frame
+// needs when time advances by a fixed step so that every run renders the same states
+static void AcquireWorld(double time)
+{
+    if (!isStepping) return;
+
+    time -= stepStartTime;
+    if (IsFixedStep())
+    {
+        unsigned long step = StepAt(time);
+        pthread_mutex_lock(&stepMutex);
+        requestedStep = step;
+        pthread_cond_broadcast(&stepChanged);
+        while (publishedStep < step) pthread_cond_wait(&stepChanged, &stepMutex);
+        pthread_mutex_unlock(&stepMutex);
+    }
+
+    const SimSnapshot* snapshot = TripleBufferRead(&snapshots);
+    framePrevious = SnapshotState(snapshot, 0);
+    frameCurrent = SnapshotState(snapshot, 1);
+
+    // Frames later than the newest step show it until the simulation catches up
+    frameAlpha = 1.0f;
+    if (snapshot->step > 0)
+    {
+        double previousTime = (snapshot->step - 1) / SimStepRate;
+        frameAlpha = (float)fmin(fmax((time - previousTime) * SimStepRate, 0.0), 1.0);
+    }
+}
+
+static void PrintUsage(const char* program)
+{
+    printf("Usage: %s [--help] [--headless] [--benchmark] [--frames count] [--fps rate] [--capture pattern]\n"
+        "          [--circles count] [--surface size] [--mesh file] [--cull mode]\n", program);
+    printf("  --help, -h         print this message and exit\n");
+    printf("  --headless         render offscreen without a visible window or vsync\n");
+    printf("  --benchmark        follow a scripted camera path without vsync and print the\n");
+    printf("                     distribution of frame times (%d frames by default)\n", SimBenchmarkFrames);
+    printf("  --frames count     exit after rendering this many frames\n");
+    printf("  --fps rate         simulated frames per second when headless or benchmarking (default 60)\n");
+    printf("  --capture pattern  write frames to files such as frames/%%05lu.png (.png, .ppm or .raw),\n");
+    printf("                     to a .y4m video, or as Y4M to the input of a command given as '|command'\n");
+    printf("  --circles count    scatter this many circles above the surface (at most %d)\n", PolygonMaxCount);
+    printf("  --surface size     vertices along each side of the surface, from 2 to %d (default 21)\n",
+        SurfaceMaxSize);
+    printf("  --mesh file        show an .obj model above the surface\n");
+    printf("  --cull mode        cull instances outside the view on the cpu (default), the gpu or none\n");
+}
+
+// Returns false if the arguments are not understood
+static bool ParseOptions(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argument, "--help") == 0 || strcmp(argument, "-h") == 0)
+        {
+            options.help = true;
+        }
+        else if (strcmp(argument, "--headless") == 0)
+        {
+            options.headless = true;
+        }
+        else if (strcmp(argument, "--benchmark") == 0)
+        {
+            options.benchmark = true;
+        }
+        else if (strcmp(argument, "--frames") == 0 && hasValue)
+        {
+            options.frameLimit = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argument, "--fps") == 0 && hasValue)
+        {
+            options.frameRate = atof(argv[++i]);
+            if (options.frameRate <= 0.0) return false;
+        }
+        else if (strcmp(argument, "--capture") == 0 && hasValue)
+        {
+            options.capturePattern = argv[++i];
+        }
+        else if (strcmp(argument, "--circles") == 0 && hasValue)
+        {
+            options.circleCount = strtoul(argv[++i], NULL, 10);
+            if (options.circleCount > PolygonMaxCount) return false;
+        }
+        else if (strcmp(argument, "--surface") == 0 && hasValue)
+        {
+            options.surfaceSize = strtoul(argv[++i], NULL, 10);
+            if (options.surfaceSize < 2 || options.surfaceSize > SurfaceMaxSize) return false;
+        }
+        else if (strcmp(argument, "--mesh") == 0 && hasValue)
+        {
+            options.meshPath = argv[++i];
+        }
+        else if (strcmp(argument, "--cull") == 0 && hasValue)
+        {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "none") == 0) options.cullMode = PolygonCullNone;
+            else if (strcmp(mode, "cpu") == 0) options.cullMode = PolygonCullCPU;
+            else if (strcmp(mode, "gpu") == 0) options.cullMode = PolygonCullGPU;
+            else return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (options.benchmark && options.frameLimit == 0) options.frameLimit = SimBenchmarkFrames;
+
+    return true;
+}
 
-// Needs to be called
 GLFWwindow* SimInitWindow(int width, int height, const char* title, int isFullscreen)
 {
     GLFWwindow* window;
 
+#ifdef GLFW_PLATFORM_NULL
+    // GLFW 3.4 can create contexts through OSMesa without a display server
+    if (options.headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
     if (!glfwInit())
     {
         printf("Failed to initialize glfw!\n");
@@ -29,7 +342,17 @@ GLFWwindow* SimInitWindow(int width, int height, const char* title, int isFullsc
     glfwWindowHint(GLFW_SAMPLES, 4);
 
     GLFWmonitor* monitor = NULL;
-    if (isFullscreen) monitor = glfwGetPrimaryMonitor();
+    if (isFullscreen && !options.headless) monitor = glfwGetPrimaryMonitor();
+
+    if (options.headless)
+    {
+        // Frames are drawn into a framebuffer object, the window only holds the context
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_SAMPLES, 0);
+#ifdef GLFW_PLATFORM_NULL
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    }
 
     window = glfwCreateWindow(width, height, title, monitor, NULL);
     if (!window)
@@ -40,8 +363,8 @@ GLFWwindow* SimInitWindow(int width, int height, const char* title, int isFullsc
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // TODO: this will break mouse position apparently
+    glfwSwapInterval(options.headless || options.benchmark ? 0 : 1);
+    if (!options.headless && !options.benchmark) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // TODO: this will break mouse position apparently
 
     if (glewInit() != GLEW_OK)
     {
@@ -49,48 +372,172 @@ GLFWwindow* SimInitWindow(int width, int height, const char* title, int isFullsc
         return NULL;
     }
 
+    DebugInitialize();
+
     InputInitialize(window);
     PolygonInitialize();
 
+#ifndef NDEBUG
+    // Edited shaders are rebuilt while the viewer runs, on a hidden context sharing
+    // objects with the window's when the driver cannot compile in the background itself
+    GLFWwindow* rebuildContext = NULL;
+    if (!GLEW_KHR_parallel_shader_compile)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        rebuildContext = glfwCreateWindow(1, 1, title, NULL, window);
+    }
+
+    ShaderWatchDirectory("shaders", rebuildContext);
+#endif
+
     return window;
 }
 
-// TODO: write build system to convert C struct into vertex attribute
-// or UBO layout in glsl shader
-
-int main()
+int main(int argc, char** argv)
 {
+    if (!ParseOptions(argc, argv))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.help)
+    {
+        PrintUsage(argv[0]);
+        return 0;
+    }
+
     GLFWwindow* window = Initialize();
+    if (window == NULL) return 1;
 
     GLCall(glEnable(GL_DEPTH_TEST));
     GLCall(glDepthFunc(GL_LESS));
 
-    double lastFrameTime = glfwGetTime();
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    // Headless frames are rendered multisampled like the window's and resolved for capture
+    Framebuffer renderTarget, resolveTarget;
+    if (options.headless)
+    {
+        if (!FramebufferInitialize(&renderTarget, width, height, 4)) return 1;
+        if (!FramebufferInitialize(&resolveTarget, width, height, 0)) return 1;
+        FramebufferBind(&renderTarget);
+    }
 
-    while (!glfwWindowShouldClose(window))
+    FrameCapture capture;
+    if (options.capturePattern && !CaptureInitialize(&capture, width, height, options.capturePattern,
+        options.frameRate))
     {
-        double currentFrameTime = glfwGetTime();
+        return 1;
+    }
+
+    Benchmark benchmark;
+    if (options.benchmark) BenchmarkInitialize(&benchmark, options.frameLimit);
+
+    if (!StartStepping()) return 1;
+
+    double lastFrameTime = SimGetTime();
+
+    // CPU time spent per frame excluding the swap, used to compare error modes
+    double totalCpuTime = 0;
+    double maxCpuTime = 0;
+
+    while (!glfwWindowShouldClose(window) && (options.frameLimit == 0 || simFrame < options.frameLimit))
+    {
+        double frameStartTime = glfwGetTime();
+        double currentFrameTime = SimGetTime();
         double deltaTime = currentFrameTime - lastFrameTime;
         lastFrameTime = currentFrameTime;
 
+        TimerBeginFrame();
+        ShaderUpdateReloads();
+
         GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
+        TimerBeginZone("Simulation wait");
+        AcquireWorld(currentFrameTime);
+        TimerEndZone();
+
+        TimerBeginZone("Update");
         Update(deltaTime);
+        TimerEndZone();
 
+        TimerBeginZone("Matrices");
         mat4 m;
         CameraViewPerspectiveMatrix(m);
         PolygonUpdateViewPerspectiveMatrix(m);
+        TimerEndZone();
 
+        TimerBeginZone("Render");
         Render(deltaTime);
-
         PolygonRenderPolygons();
+        TimerEndZone();
 
         InputReset();
+        RendererEndFrame();
 
-        glfwSwapBuffers(window);
+        if (options.capturePattern)
+        {
+            TimerBeginZone("Capture");
+            if (options.headless) FramebufferResolve(&renderTarget, &resolveTarget);
+            CaptureFrame(&capture);
+            if (options.headless) FramebufferBind(&renderTarget);
+            TimerEndZone();
+        }
+
+        double cpuTime = glfwGetTime() - frameStartTime;
+        totalCpuTime += cpuTime;
+        maxCpuTime = fmax(maxCpuTime, cpuTime);
+        simFrame++;
+
+        if (!options.headless)
+        {
+            TimerBeginZone("Swap");
+            glfwSwapBuffers(window);
+            TimerEndZone();
+        }
+
+        // Benchmark frames wait for the GPU so that each frame's time includes its rendering
+        // rather than queueing work for later frames
+        if (options.benchmark)
+        {
+            TimerBeginZone("Finish");
+            GLCall(glFinish());
+            TimerEndZone();
+        }
+
+        TimerBeginZone("Poll");
         glfwPollEvents();
+        TimerEndZone();
+
+        TimerEndFrame();
+
+        if (options.benchmark) BenchmarkAddFrame(&benchmark, glfwGetTime() - frameStartTime);
+
+        ArenaFrameReset();
     }
 
+    if (simFrame > 0)
+    {
+        printf("Frame CPU time (GL errors: %s): avg %.3f ms, max %.3f ms over %lu frames\n",
+            DebugErrorModeName(), totalCpuTime * 1000.0 / simFrame, maxCpuTime * 1000.0,
+            simFrame);
+        TimerPrintSummary();
+    }
+
+    if (options.benchmark)
+    {
+        BenchmarkPrintSummary(&benchmark);
+        BenchmarkDelete(&benchmark);
+    }
+
+    StopStepping();
+    JobSystemShutdown();
+    ShaderStopWatching();
+
+    if (options.capturePattern) CaptureFinish(&capture);
+
     printf("Exiting...\n");
 
     glfwTerminate();
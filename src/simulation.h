@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "polygon.h"
+#include <GLFW\glfw3.h>
+
+// Options given on the command line
+typedef struct SimOptions
+{
+    bool headless; // Render offscreen, without showing a window or waiting for vsync
+    bool benchmark; // Follow a scripted camera path without vsync and report frame times
+    unsigned long frameLimit; // Exit after this many frames, or never if zero
+    double frameRate; // Frames per second of simulated time when headless or benchmarking
+    const char* capturePattern; // Frames are written to files named by this pattern if set
+    unsigned int circleCount; // Circles scattered above the surface
+    unsigned int surfaceSize; // Vertices along each side of the surface
+    const char* meshPath; // An .obj model shown above the surface if set
+    PolygonCullMode cullMode; // How circles outside the view are culled
+    bool help; // Print the usage and exit
+} SimOptions;
+
+// Frames rendered by a benchmark unless --frames is given
+#define SimBenchmarkFrames 600
+
+// Steps per second of the simulation thread, which advances the world independently of
+// the frame rate
+#define SimStepRate 120.0
+
+const SimOptions* SimGetOptions();
+
+// Creates the window and initializes the renderer; needs to be called first
+GLFWwindow* SimInitWindow(int width, int height, const char* title, int isFullscreen);
+
+// Seconds since the simulation started; advances by a fixed step per frame when
+// headless or benchmarking
+double SimGetTime();
+
+// Sets the world the simulation thread starts from when the main loop begins; its `size`
+// bytes are copied into every snapshot, so it must not hold pointers to itself
+// Step computes each state from the last on the simulation thread
+void SimInitializeWorld(const void* world, size_t size);
+
+// Gets the two newest states of the world and how far the current frame is between them,
+// from 0 at `previous` to 1 at `current`; both stay valid until the next frame
+// Both are NULL if no world is being stepped
+void SimGetWorld(const void** previous, const void** current, float* alpha);
\ No newline at end of file
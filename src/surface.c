@@ -0,0 +1,1339 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+#include <cglm\cglm.h>
+#include "surface.h"
+#include "shader.h"
+#include "renderer.h"
+#include "camera.h"
+#include "cull.h"
+#include "parallel.h"
+#include "simd_math.h"
+#include "debug.h"
+#include "timer.h"
+#include "arena.h"
+
+static const char* BasicFragShaderPath = "shaders/BasicFrag.frag";
+const char* SurfaceVertShaderPath = "shaders/Surface.vert";
+
+// Replaced by the height function of analytic surfaces
+static const char* SurfaceFunctionMarker = "// #SurfaceFunction";
+
+// Rows are evaluated in blocks of this many columns
+#define SurfaceBlockSize 256
+
+// The minimum number of grid points evaluated by a thread
+#define SurfacePointsPerThread 65536
+
+// Tiles within this many tile widths of the camera are drawn at full detail by default
+#define SurfaceLodDistanceTiles 8.0f
+
+// Ends a triangle strip (GL_PRIMITIVE_RESTART_FIXED_INDEX for unsigned int indices)
+#define SurfaceRestartIndex 0xFFFFFFFF
+
+typedef struct SurfaceGenerateContext
+{
+    Surface* surface;
+    const SurfaceDomain* domain;
+    float time;
+    SurfaceFunction function; // NULL to read the current heights
+    void* userData;
+    unsigned int firstTileRow;
+} SurfaceGenerateContext;
+
+static unsigned int surfaceShaderId;
+static UniformBuffer* matricesBuffer;
+static Frustum frustum;
+static SurfacePrimitiveMode primitiveMode = SurfacePrimitiveTriangles;
+static SurfaceIndexBuffer* indexBuffers;
+static vec3 lightDirection;
+
+void SurfacesInitialize(UniformBuffer* vpMatrixBuffer, unsigned int shaderId)
+{
+    matricesBuffer = vpMatrixBuffer;
+    surfaceShaderId = shaderId;
+    ShaderBindUniformBuffer(surfaceShaderId, "Matrices", vpMatrixBuffer);
+    GLCall(glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX));
+    SurfacesSetLightDirection((vec3) { 0.3f, 1.0f, 0.5f });
+}
+
+void SurfacesSetLightDirection(vec3 direction)
+{
+    glm_vec3_copy(direction, lightDirection);
+    glm_vec3_normalize(lightDirection);
+}
+
+void SurfacesUpdateViewPerspectiveMatrix(mat4 vpMatrix)
+{
+    FrustumFromMatrix(vpMatrix, &frustum);
+}
+
+// Returns the largest power of two tile size up to SurfaceMaxTileSize that divides
+// the grid evenly. If none from SurfaceMinTileSize up does, returns the largest that fits
+// in the grid, leaving a narrower last tile row and column
+static uint32_t ChooseTileSize(uint32_t n)
+{
+    uint32_t tileSize = SurfaceMaxTileSize;
+    while ((n - 1) % tileSize != 0) tileSize /= 2;
+    if (tileSize >= SurfaceMinTileSize) return tileSize;
+
+    tileSize = SurfaceMaxTileSize;
+    while (tileSize > n - 1) tileSize /= 2;
+    return tileSize;
+}
+
+// Returns the number of grid squares across a tile column or row
+static uint32_t TileExtent(const Surface* surface, unsigned int tile)
+{
+    return tile + 1 == surface->tileCount ? surface->lastTileSize : surface->tileSize;
+}
+
+// Appends triangles to an index buffer as a list or as strips
+typedef struct IndexWriter
+{
+    unsigned int* indices;
+    unsigned int count;
+    uint32_t n;
+    bool strips;
+    unsigned int stripLength; // Vertices in the current strip
+} IndexWriter;
+
+// Returns whether the vertices at relative indices a, b and c wind like the full detail grid
+static bool IsFrontFacing(uint32_t n, unsigned int a, unsigned int b, unsigned int c)
+{
+    int ax = a % n, ay = a / n;
+    int bx = b % n, by = b / n;
+    int cx = c % n, cy = c / n;
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax) > 0;
+}
+
+// Returns whether adding vertex v to the strip makes a front facing triangle
+// Every other triangle of a strip has its first two vertices swapped
+static bool StripTriangleFrontFacing(IndexWriter* writer, unsigned int v)
+{
+    unsigned int p = writer->indices[writer->count - 2];
+    unsigned int q = writer->indices[writer->count - 1];
+    bool odd = (writer->stripLength - 2) % 2;
+    return odd ? IsFrontFacing(writer->n, q, p, v) : IsFrontFacing(writer->n, p, q, v);
+}
+
+static void PushIndex(IndexWriter* writer, unsigned int index)
+{
+    writer->indices[writer->count++] = index;
+    writer->stripLength++;
+}
+
+// Continues the current strip with front facing triangle (a, b, c) if it shares the strip's
+// last edge, otherwise restarts the strip
+static void AppendStripTriangle(IndexWriter* writer, unsigned int a, unsigned int b, unsigned int c)
+{
+    if (writer->stripLength >= 2)
+    {
+        unsigned int p = writer->indices[writer->count - 2];
+        unsigned int q = writer->indices[writer->count - 1];
+        int shared = (a == p || a == q) + (b == p || b == q) + (c == p || c == q);
+        unsigned int v = (a != p && a != q) ? a : (b != p && b != q) ? b : c;
+
+        if (shared == 2)
+        {
+            if (StripTriangleFrontFacing(writer, v))
+            {
+                PushIndex(writer, v);
+                return;
+            }
+
+            // A degenerate triangle reverses the last edge
+            PushIndex(writer, p);
+            if (StripTriangleFrontFacing(writer, v))
+            {
+                PushIndex(writer, v);
+                return;
+            }
+
+            writer->count--;
+        }
+
+        writer->indices[writer->count++] = SurfaceRestartIndex;
+    }
+
+    writer->stripLength = 0;
+    PushIndex(writer, a);
+    PushIndex(writer, b);
+    PushIndex(writer, c);
+}
+
+// Appends triangle (a, b, c) given in grid coordinates, wound the same way as the full detail grid
+static void EmitTriangle(IndexWriter* writer, int ax, int ay, int bx, int by, int cx, int cy)
+{
+    if ((bx - ax) * (cy - ay) - (by - ay) * (cx - ax) < 0)
+    {
+        int tx = bx, ty = by;
+        bx = cx; by = cy;
+        cx = tx; cy = ty;
+    }
+
+    uint32_t n = writer->n;
+    unsigned int a = ax + ay * n;
+    unsigned int b = bx + by * n;
+    unsigned int c = cx + cy * n;
+
+    if (writer->strips)
+    {
+        AppendStripTriangle(writer, a, b, c);
+        return;
+    }
+
+    writer->indices[writer->count++] = a;
+    writer->indices[writer->count++] = b;
+    writer->indices[writer->count++] = c;
+}
+
+// Maps a distance u along a tile edge and a depth into the tile to grid coordinates
+// Edges are numbered clockwise from the top (y = 0)
+static void EdgeToGrid(int edge, int tileSize, int u, int depth, int* x, int* y)
+{
+    switch (edge)
+    {
+        case 0: *x = u; *y = depth; break;
+        case 1: *x = tileSize - depth; *y = u; break;
+        case 2: *x = tileSize - u; *y = tileSize - depth; break;
+        default: *x = depth; *y = tileSize - u; break;
+    }
+}
+
+// Appends the squares of a grid at a step of `step` from grid coordinates (start, start)
+// to (endX, endY). Squares are emitted column by column, which lets each column form one strip
+static void EmitGrid(IndexWriter* writer, int start, int endX, int endY, int step)
+{
+    for (int x = start; x + step <= endX; x += step)
+    {
+        for (int y = start; y + step <= endY; y += step)
+        {
+            EmitTriangle(writer, x, y, x + step, y, x, y + step);
+            EmitTriangle(writer, x + step, y, x + step, y + step, x, y + step);
+        }
+    }
+}
+
+/* Tile triangulation at a step of s grid squares
+ o---o---o---o---o   The border (o) keeps the resolution of the edge, which is s, or 2s
+ |\ /|   |   |\ /|   when the neighbouring tile is one level coarser. The interior (i)
+ | i---i---i---i |   is a grid at step s. Each side of the ring between them is "zipped"
+ o |   |   |   | o   by walking both rows of vertices and always advancing the one
+ ...                 whose next vertex is nearer, so edges shared with neighbours match.
+*/
+static void BuildIndexSet(IndexWriter* writer, int tileSize, int step, unsigned int edgeMask)
+{
+    writer->stripLength = 0;
+
+    if (step == 1 && edgeMask == 0)
+    {
+        EmitGrid(writer, 0, tileSize, tileSize, 1);
+        return;
+    }
+
+    EmitGrid(writer, step, tileSize - step, tileSize - step, step);
+
+    for (int edge = 0; edge < 4; edge++)
+    {
+        int outerStep = (edgeMask & (1 << edge)) ? 2 * step : step;
+        int outerCount = tileSize / outerStep;
+        int innerCount = (tileSize - 2 * step) / step;
+
+        int i = 0, j = 0;
+        while (i < outerCount || j < innerCount)
+        {
+            int outerU = i * outerStep;
+            int innerU = step + j * step;
+            int ax, ay, bx, by, cx, cy;
+
+            EdgeToGrid(edge, tileSize, outerU, 0, &ax, &ay);
+            if (j == innerCount || (i < outerCount && outerU + outerStep <= innerU + step))
+            {
+                EdgeToGrid(edge, tileSize, outerU + outerStep, 0, &bx, &by);
+                EdgeToGrid(edge, tileSize, innerU, step, &cx, &cy);
+                i++;
+            }
+            else
+            {
+                EdgeToGrid(edge, tileSize, innerU + step, step, &bx, &by);
+                EdgeToGrid(edge, tileSize, innerU, step, &cx, &cy);
+                j++;
+            }
+
+            EmitTriangle(writer, ax, ay, bx, by, cx, cy);
+        }
+    }
+}
+
+// Builds the index sets of every level of detail and edge mask into one index buffer,
+// followed by the full detail sets of narrow last tiles if the tiles do not fit exactly
+// Indices are relative to the top left vertex of a tile, which is added as the base vertex
+static void BuildIndexBuffer(SurfaceIndexBuffer* indexBuffer, VertexArray* va, int tileSize,
+    int lastTileSize)
+{
+    // A level halves the step of the one before it and needs at least two steps per tile
+    indexBuffer->lodCount = 1;
+    while (indexBuffer->lodCount < SurfaceMaxLodCount)
+    {
+        int nextStep = 1 << indexBuffer->lodCount;
+        if (tileSize % nextStep != 0 || tileSize < 2 * nextStep) break;
+        indexBuffer->lodCount++;
+    }
+
+    // A strip needs at most one restart per triangle
+    unsigned int maxSetCount = 8 * tileSize * tileSize + 32 * tileSize;
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    IndexWriter writer = { 0 };
+    writer.indices = ArenaAlloc(scratch, sizeof(unsigned int) * maxSetCount *
+        (indexBuffer->lodCount * SurfaceEdgeMaskCount + SurfacePartialSetCount));
+    writer.n = indexBuffer->n;
+    writer.strips = indexBuffer->mode == SurfacePrimitiveStrips;
+
+    for (unsigned int lod = 0; lod < indexBuffer->lodCount; lod++)
+    {
+        for (unsigned int mask = 0; mask < SurfaceEdgeMaskCount; mask++)
+        {
+            SurfaceIndexSet* set = &indexBuffer->indexSets[lod * SurfaceEdgeMaskCount + mask];
+
+            // The coarsest level has no coarser neighbours
+            if (lod + 1 == indexBuffer->lodCount && mask != 0)
+            {
+                *set = indexBuffer->indexSets[lod * SurfaceEdgeMaskCount];
+                continue;
+            }
+
+            set->first = writer.count;
+            BuildIndexSet(&writer, tileSize, 1 << lod, mask);
+            set->count = writer.count - set->first;
+        }
+    }
+
+    // The last column, the last row and the corner
+    int partialWidths[SurfacePartialSetCount] = { lastTileSize, tileSize, lastTileSize };
+    int partialHeights[SurfacePartialSetCount] = { tileSize, lastTileSize, lastTileSize };
+    for (int i = 0; i < SurfacePartialSetCount && lastTileSize < tileSize; i++)
+    {
+        SurfaceIndexSet* set = &indexBuffer->partialSets[i];
+        set->first = writer.count;
+        writer.stripLength = 0;
+        EmitGrid(&writer, 0, partialWidths[i], partialHeights[i], 1);
+        set->count = writer.count - set->first;
+    }
+
+    IndexBufferInitialize(va, writer.indices, writer.count, GL_STATIC_DRAW);
+    indexBuffer->bufferId = va->indexBufferId;
+    indexBuffer->count = writer.count;
+
+    ArenaRestore(scratch, mark);
+}
+
+// Attaches the shared index buffer for the surface's grid size to its vertex array,
+// building it the first time that size is used; the vertex array must be bound
+static void AcquireIndexBuffer(Surface* surface)
+{
+    SurfaceIndexBuffer* indexBuffer = indexBuffers;
+    while (indexBuffer && (indexBuffer->n != surface->n || indexBuffer->mode != primitiveMode))
+    {
+        indexBuffer = indexBuffer->next;
+    }
+
+    if (indexBuffer)
+    {
+        IndexBufferAttach(&surface->vertexArray, indexBuffer->bufferId, indexBuffer->count);
+    }
+    else
+    {
+        indexBuffer = calloc(1, sizeof(SurfaceIndexBuffer));
+        indexBuffer->n = surface->n;
+        indexBuffer->mode = primitiveMode;
+        BuildIndexBuffer(indexBuffer, &surface->vertexArray, surface->tileSize,
+            surface->lastTileSize);
+
+        indexBuffer->next = indexBuffers;
+        indexBuffers = indexBuffer;
+    }
+
+    indexBuffer->refCount++;
+    surface->indexBuffer = indexBuffer;
+}
+
+// Deletes the shared index buffer once no surface uses it
+static void ReleaseIndexBuffer(Surface* surface)
+{
+    SurfaceIndexBuffer* indexBuffer = surface->indexBuffer;
+    surface->indexBuffer = NULL;
+    if (--indexBuffer->refCount > 0) return;
+
+    SurfaceIndexBuffer** link = &indexBuffers;
+    while (*link != indexBuffer) link = &(*link)->next;
+    *link = indexBuffer->next;
+
+    IndexBufferDelete(&surface->vertexArray);
+    free(indexBuffer);
+}
+
+void SurfaceSetPrimitiveMode(SurfacePrimitiveMode mode)
+{
+    primitiveMode = mode;
+}
+
+static void UpdateTileRowBounds(Surface* surface, unsigned int firstTileRow, unsigned int tileRowCount);
+static void UpdateTileSphere(Surface* surface, SurfaceTile* tile);
+
+static void InitializeSurface(Surface* surface, vec3 origin, float scale, float* heights, uint32_t n,
+    uint32_t storageRows)
+{
+    glm_vec3_copy(origin, surface->origin);
+    surface->scale = scale;
+    surface->n = n;
+    surface->storageRows = storageRows;
+
+    size_t dataSize = sizeof(float) * n * storageRows;
+    surface->heights = heights;
+
+    // The initial data is uploaded with the buffer
+    surface->dirtyRows = calloc(storageRows, 1);
+    surface->dirtyColumnStart = n;
+    surface->dirtyColumnEnd = 0;
+    surface->uploadedBytes = 0;
+
+    VertexArray* va = &surface->vertexArray;
+
+    VertexArrayInitialize(va);
+    VertexArrayBind(va);
+
+    // Colors, if any, are in a separate static buffer so that height updates stay small
+    // Analytic surfaces have no vertex data; gl_VertexID alone places their vertices
+    if (heights)
+    {
+        VertexBufferInitialize(va, heights, dataSize, GL_DYNAMIC_DRAW);
+        VertexAttribPointerFloats(0, 1, 4, 0); // height
+    }
+
+    surface->shaderId = surfaceShaderId;
+
+    surface->colorMode = SurfaceColorGrid;
+    surface->colorBufferId = 0;
+    surface->colormapTextureId = 0;
+
+    // Normals are allocated when lighting is first enabled
+    surface->lit = false;
+    surface->normals = NULL;
+    surface->normalBufferId = 0;
+    surface->dirtyNormalRows = calloc(storageRows, 1);
+
+    surface->tileSize = ChooseTileSize(n);
+    surface->tileCount = (n - 2) / surface->tileSize + 1;
+    surface->lastTileSize = n - 1 - (surface->tileCount - 1) * surface->tileSize;
+    surface->lodDistance = SurfaceLodDistanceTiles * surface->tileSize * scale;
+
+    AcquireIndexBuffer(surface);
+
+    VertexArrayUnbind();
+
+    unsigned int tileCount = surface->tileCount * surface->tileCount;
+    surface->tiles = malloc(sizeof(SurfaceTile) * tileCount);
+    surface->visibleTiles = malloc(sizeof(SurfaceTile) * tileCount);
+    surface->tileLods = malloc(tileCount);
+    surface->visibleTileCount = 0;
+    for (unsigned int i = 0; i < tileCount; i++)
+    {
+        surface->tiles[i].x = i % surface->tileCount;
+        surface->tiles[i].y = i / surface->tileCount;
+    }
+
+    surface->drawCommands = calloc(tileCount, sizeof(DrawElementsIndirectCommand));
+    IndirectBufferInitializeElements(&surface->drawCommandsBuffer, surface->drawCommands,
+        tileCount, GL_STREAM_DRAW);
+}
+
+void SurfaceInitialize(Surface* surface, vec3 origin, float scale, float* heights, uint32_t n)
+{
+    surface->streaming = false;
+    surface->streamRow = 0;
+    surface->rowBounds = NULL;
+    surface->boundsDirty = false;
+
+    InitializeSurface(surface, origin, scale, heights, n, n);
+    UpdateTileRowBounds(surface, 0, surface->tileCount);
+}
+
+// Compiles the surface shader with a height function spliced in
+static unsigned int CreateAnalyticShader(const char* function)
+{
+    static const char* format =
+        "#define SURFACE_FUNCTION\n"
+        "float SurfaceHeight(float x, float y, float t)\n"
+        "{\n%s\n}\n";
+
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    size_t size = strlen(format) + strlen(function);
+    char* source = ArenaAlloc(scratch, size);
+    snprintf(source, size, format, function);
+
+    unsigned int shaderId = ShaderCreateTemplate(SurfaceVertShaderPath, BasicFragShaderPath,
+        SurfaceFunctionMarker, source);
+    ArenaRestore(scratch, mark);
+    if (!shaderId) return 0;
+
+    ShaderBindUniformBuffer(shaderId, "Matrices", matricesBuffer);
+    return shaderId;
+}
+
+bool SurfaceInitializeAnalytic(Surface* surface, vec3 origin, float scale, uint32_t n,
+    const SurfaceDomain* domain, const char* function, float minHeight, float maxHeight)
+{
+    unsigned int shaderId = CreateAnalyticShader(function);
+    if (!shaderId) return false;
+
+    surface->streaming = false;
+    surface->streamRow = 0;
+    surface->rowBounds = NULL;
+    surface->boundsDirty = false;
+
+    InitializeSurface(surface, origin, scale, NULL, n, n);
+    surface->shaderId = shaderId;
+    surface->domain = *domain;
+    surface->time = 0.0f;
+
+    // Every tile is bounded by the whole height range
+    for (unsigned int i = 0; i < surface->tileCount * surface->tileCount; i++)
+    {
+        surface->tiles[i].minHeight = minHeight;
+        surface->tiles[i].maxHeight = maxHeight;
+        UpdateTileSphere(surface, &surface->tiles[i]);
+    }
+
+    return true;
+}
+
+void SurfaceSetTime(Surface* surface, float time)
+{
+    surface->time = time;
+}
+
+void SurfaceInitializeStreaming(Surface* surface, vec3 origin, float scale, uint32_t n)
+{
+    // The first tile row is repeated after the last ring row so that every tile
+    // is a contiguous block of rows wherever the ring starts
+    uint32_t storageRows = n + ChooseTileSize(n);
+    float* heights = calloc((size_t)n * storageRows, sizeof(float));
+
+    surface->streaming = true;
+    surface->streamRow = 0;
+
+    InitializeSurface(surface, origin, scale, heights, n, storageRows);
+
+    surface->rowBounds = calloc((size_t)n * surface->tileCount * 2, sizeof(float));
+    surface->boundsDirty = true;
+}
+
+void SurfaceDelete(Surface* surface)
+{
+    ReleaseIndexBuffer(surface);
+    VertexBufferDelete(&surface->vertexArray);
+    VertexArrayDelete(&surface->vertexArray);
+    IndirectBufferDelete(&surface->drawCommandsBuffer);
+
+    free(surface->tiles);
+    free(surface->visibleTiles);
+    free(surface->tileLods);
+    free(surface->drawCommands);
+    free(surface->dirtyRows);
+    free(surface->dirtyNormalRows);
+    free(surface->normals);
+    free(surface->rowBounds);
+
+    if (surface->colorBufferId)
+    {
+        RendererForgetBuffer(surface->colorBufferId);
+        GLCall(glDeleteBuffers(1, &surface->colorBufferId));
+    }
+
+    if (surface->colormapTextureId)
+    {
+        GLCall(glDeleteTextures(1, &surface->colormapTextureId));
+    }
+
+    if (surface->normalBufferId)
+    {
+        RendererForgetBuffer(surface->normalBufferId);
+        GLCall(glDeleteBuffers(1, &surface->normalBufferId));
+    }
+
+    if (surface->shaderId != surfaceShaderId) ShaderDelete(surface->shaderId);
+
+    if (surface->streaming) free(surface->heights);
+}
+
+void SurfaceSetColors(Surface* surface, const unsigned char* colors)
+{
+    uint32_t n = surface->n;
+    size_t rowSize = 4 * n;
+    Arena* scratch = ArenaScratch();
+    ArenaMark mark = ArenaSave(scratch);
+
+    unsigned char* data = ArenaAlloc(scratch, rowSize * surface->storageRows);
+    memcpy(data, colors, rowSize * n);
+
+    // Streaming surfaces repeat the first tile row after the last
+    if (surface->storageRows > n)
+    {
+        memcpy(data + rowSize * n, colors, rowSize * (surface->storageRows - n));
+    }
+
+    VertexArrayBind(&surface->vertexArray);
+
+    if (!surface->colorBufferId)
+    {
+        GLCall(glGenBuffers(1, &surface->colorBufferId));
+    }
+
+    RendererBindBuffer(GL_ARRAY_BUFFER, surface->colorBufferId);
+    GLCall(glBufferData(GL_ARRAY_BUFFER, rowSize * surface->storageRows, data, GL_STATIC_DRAW));
+    VertexAttribPointerNormalizedUBytes(1, 4, 4); // color rgba
+
+    VertexArrayUnbind();
+    ArenaRestore(scratch, mark);
+
+    surface->colorMode = SurfaceColorVertex;
+}
+
+void SurfaceSetColormap(Surface* surface, const unsigned char* colormap, unsigned int count,
+    float minHeight, float maxHeight)
+{
+    if (!surface->colormapTextureId)
+    {
+        GLCall(glGenTextures(1, &surface->colormapTextureId));
+    }
+
+    GLCall(glBindTexture(GL_TEXTURE_1D, surface->colormapTextureId));
+    GLCall(glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, colormap));
+    GLCall(glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GLCall(glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GLCall(glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+
+    surface->colormapRange[0] = minHeight;
+    surface->colormapRange[1] = maxHeight;
+    surface->colorMode = SurfaceColorMap;
+}
+
+void SurfaceSetLighting(Surface* surface, bool lit)
+{
+    surface->lit = lit;
+
+    // Analytic surfaces differentiate their function in the vertex shader
+    if (!lit || surface->normalBufferId || !surface->heights) return;
+
+    surface->normals = malloc(sizeof(uint32_t) * surface->n * surface->storageRows);
+
+    VertexArrayBind(&surface->vertexArray);
+
+    GLCall(glGenBuffers(1, &surface->normalBufferId));
+    RendererBindBuffer(GL_ARRAY_BUFFER, surface->normalBufferId);
+    GLCall(glBufferData(GL_ARRAY_BUFFER, sizeof(uint32_t) * surface->n * surface->storageRows, NULL,
+        GL_DYNAMIC_DRAW));
+    VertexAttribPointerPackedNormals(2, 4); // normal
+
+    VertexArrayUnbind();
+
+    // Every normal is computed by the next draw
+    memset(surface->dirtyNormalRows, 1, surface->n);
+}
+
+// Widens the height range of the tiles in one tile row to include a block of heights
+// starting at column `column`. Tile t spans columns t * tileSize to (t + 1) * tileSize inclusive
+static void IncludeHeights(Surface* surface, SurfaceTile* tileRow, unsigned int column,
+    unsigned int count, const float* heights)
+{
+    unsigned int tileSize = surface->tileSize;
+    unsigned int tile = column / tileSize;
+    if (column % tileSize == 0 && tile > 0) tile--;
+
+    for (; tile < surface->tileCount && tile * tileSize < column + count; tile++)
+    {
+        unsigned int start = tile * tileSize > column ? tile * tileSize - column : 0;
+        unsigned int end = tile * tileSize + tileSize + 1 - column;
+        end = end < count ? end : count;
+
+        float minHeight = tileRow[tile].minHeight;
+        float maxHeight = tileRow[tile].maxHeight;
+        for (unsigned int i = start; i < end; i++)
+        {
+            minHeight = heights[i] < minHeight ? heights[i] : minHeight;
+            maxHeight = heights[i] > maxHeight ? heights[i] : maxHeight;
+        }
+
+        tileRow[tile].minHeight = minHeight;
+        tileRow[tile].maxHeight = maxHeight;
+    }
+}
+
+// Computes the bounding sphere of a tile from its height range
+static void UpdateTileSphere(Surface* surface, SurfaceTile* tile)
+{
+    float halfWidth = 0.5f * TileExtent(surface, tile->x) * surface->scale;
+    float halfDepth = 0.5f * TileExtent(surface, tile->y) * surface->scale;
+    float halfHeight = 0.5f * (tile->maxHeight - tile->minHeight);
+
+    tile->center[0] = surface->origin[0] + tile->x * surface->tileSize * surface->scale + halfWidth;
+    tile->center[1] = surface->origin[1] + 0.5f * (tile->maxHeight + tile->minHeight);
+    tile->center[2] = surface->origin[2] + tile->y * surface->tileSize * surface->scale + halfDepth;
+    tile->radius = sqrtf(halfWidth * halfWidth + halfDepth * halfDepth + halfHeight * halfHeight);
+}
+
+// Evaluates a range of tile rows, writing them into the surface heights
+// The row shared with the next tile row is evaluated for the bounds but written by
+// the thread that owns it, so that each tile is only touched by one thread
+static void GenerateTileRows(unsigned int startTileRow, unsigned int endTileRow, void* context)
+{
+    SurfaceGenerateContext* generate = context;
+    const SurfaceDomain* domain = generate->domain;
+    Surface* surface = generate->surface;
+    uint32_t n = surface->n;
+    uint32_t tileSize = surface->tileSize;
+
+    float x[SurfaceBlockSize];
+    float boundaryHeights[SurfaceBlockSize];
+
+    startTileRow += generate->firstTileRow;
+    endTileRow += generate->firstTileRow;
+
+    for (unsigned int tileRow = startTileRow; tileRow < endTileRow; tileRow++)
+    {
+        SurfaceTile* tiles = surface->tiles + tileRow * surface->tileCount;
+        for (unsigned int t = 0; t < surface->tileCount; t++)
+        {
+            tiles[t].minHeight = FLT_MAX;
+            tiles[t].maxHeight = -FLT_MAX;
+        }
+
+        unsigned int lastRow = tileRow * tileSize + TileExtent(surface, tileRow);
+        for (unsigned int r = tileRow * tileSize; r <= lastRow; r++)
+        {
+            float* row = surface->heights + (size_t)r * n;
+            bool writeRow = r < lastRow || r == n - 1;
+
+            for (unsigned int c = 0; c < n; c += SurfaceBlockSize)
+            {
+                unsigned int count = n - c < SurfaceBlockSize ? n - c : SurfaceBlockSize;
+
+                // Heights are written straight into the row unless another thread owns it
+                float* heights = writeRow ? row + c : boundaryHeights;
+
+                if (generate->function)
+                {
+                    float y = domain->min[1] + r * domain->step;
+                    for (unsigned int i = 0; i < count; i++)
+                    {
+                        x[i] = domain->min[0] + (c + i) * domain->step;
+                    }
+
+                    generate->function(x, y, generate->time, count, heights, generate->userData);
+                }
+                else
+                {
+                    heights = row + c;
+                }
+
+                IncludeHeights(surface, tiles, c, count, heights);
+            }
+        }
+
+        for (unsigned int t = 0; t < surface->tileCount; t++)
+        {
+            UpdateTileSphere(surface, &tiles[t]);
+        }
+    }
+}
+
+// Rereads the heights of a range of tile rows to update their bounds
+static void UpdateTileRowBounds(Surface* surface, unsigned int firstTileRow, unsigned int tileRowCount)
+{
+    SurfaceGenerateContext context = { surface, NULL, 0.0f, NULL, NULL, firstTileRow };
+    unsigned int minTileRows = SurfacePointsPerThread / (surface->n * surface->tileSize) + 1;
+    ParallelFor(tileRowCount, minTileRows, GenerateTileRows, &context);
+}
+
+// Computes the height range of a ring row of a streaming surface within each tile column
+static void UpdateRowBounds(Surface* surface, uint32_t row)
+{
+    const float* heights = surface->heights + (size_t)row * surface->n;
+    float* bounds = surface->rowBounds + (size_t)row * surface->tileCount * 2;
+    uint32_t tileSize = surface->tileSize;
+
+    for (unsigned int t = 0; t < surface->tileCount; t++)
+    {
+        float minHeight = FLT_MAX;
+        float maxHeight = -FLT_MAX;
+        for (unsigned int c = t * tileSize; c <= t * tileSize + TileExtent(surface, t); c++)
+        {
+            float height = heights[c];
+            minHeight = height < minHeight ? height : minHeight;
+            maxHeight = height > maxHeight ? height : maxHeight;
+        }
+
+        bounds[t * 2] = minHeight;
+        bounds[t * 2 + 1] = maxHeight;
+    }
+}
+
+// Combines the row bounds of the ring rows shown in each tile of a streaming surface
+static void UpdateStreamingTileBounds(Surface* surface)
+{
+    uint32_t n = surface->n;
+    uint32_t tileSize = surface->tileSize;
+    uint32_t tileCount = surface->tileCount;
+
+    for (unsigned int tileRow = 0; tileRow < tileCount; tileRow++)
+    {
+        SurfaceTile* tiles = surface->tiles + tileRow * tileCount;
+        for (unsigned int t = 0; t < tileCount; t++)
+        {
+            tiles[t].minHeight = FLT_MAX;
+            tiles[t].maxHeight = -FLT_MAX;
+        }
+
+        for (unsigned int i = 0; i <= TileExtent(surface, tileRow); i++)
+        {
+            uint32_t row = (tileRow * tileSize + surface->streamRow + i) % n;
+            const float* bounds = surface->rowBounds + (size_t)row * tileCount * 2;
+            for (unsigned int t = 0; t < tileCount; t++)
+            {
+                tiles[t].minHeight = bounds[t * 2] < tiles[t].minHeight ? bounds[t * 2] : tiles[t].minHeight;
+                tiles[t].maxHeight = bounds[t * 2 + 1] > tiles[t].maxHeight ? bounds[t * 2 + 1] : tiles[t].maxHeight;
+            }
+        }
+
+        for (unsigned int t = 0; t < tileCount; t++)
+        {
+            UpdateTileSphere(surface, &tiles[t]);
+        }
+    }
+
+    surface->boundsDirty = false;
+}
+
+// Flags vertices for upload
+static void MarkDirty(Surface* surface, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    memset(surface->dirtyRows + y, 1, height);
+    if (x < surface->dirtyColumnStart) surface->dirtyColumnStart = x;
+    if (x + width > surface->dirtyColumnEnd) surface->dirtyColumnEnd = x + width;
+}
+
+// Flags the normals that depend on a range of ring rows: the rows and their neighbours
+static void MarkNormalsDirty(Surface* surface, uint32_t y, uint32_t height)
+{
+    int n = surface->n;
+    for (int row = (int)y - 1; row <= (int)(y + height); row++)
+    {
+        if (surface->streaming)
+        {
+            surface->dirtyNormalRows[(row + n) % n] = 1;
+        }
+        else if (row >= 0 && row < n)
+        {
+            surface->dirtyNormalRows[row] = 1;
+        }
+    }
+}
+
+// Evaluates the function over the grid; tile rows are split across threads
+void SurfaceGenerate(Surface* surface, const SurfaceDomain* domain, float time,
+    SurfaceFunction function, void* userData)
+{
+    // Analytic surfaces have no heights to fill
+    if (!surface->heights) return;
+
+    SurfaceGenerateContext context = { surface, domain, time, function, userData, 0 };
+    unsigned int minTileRows = SurfacePointsPerThread / (surface->n * surface->tileSize) + 1;
+    ParallelFor(surface->tileCount, minTileRows, GenerateTileRows, &context);
+    MarkDirty(surface, 0, 0, surface->n, surface->n);
+    MarkNormalsDirty(surface, 0, surface->n);
+}
+
+void SurfaceMarkRowsChanged(Surface* surface, uint32_t firstRow, uint32_t rowCount)
+{
+    SurfaceMarkRegionChanged(surface, 0, firstRow, surface->n, rowCount);
+}
+
+void SurfaceMarkRegionChanged(Surface* surface, uint32_t x, uint32_t y, uint32_t width,
+    uint32_t height)
+{
+    if (!surface->heights || width == 0 || height == 0) return;
+
+    MarkDirty(surface, x, y, width, height);
+    MarkNormalsDirty(surface, y, height);
+
+    if (surface->streaming)
+    {
+        // Rows are ring rows; copies of the first tile row follow the last ring row
+        uint32_t n = surface->n;
+        for (uint32_t row = y; row < y + height; row++)
+        {
+            if (row < surface->tileSize)
+            {
+                memcpy(surface->heights + (size_t)(n + row) * n + x,
+                    surface->heights + (size_t)row * n + x, sizeof(float) * width);
+                MarkDirty(surface, x, n + row, width, 1);
+            }
+
+            UpdateRowBounds(surface, row);
+        }
+
+        surface->boundsDirty = true;
+        return;
+    }
+
+    // Tile row t spans rows t * tileSize to (t + 1) * tileSize inclusive
+    unsigned int firstTileRow = y / surface->tileSize;
+    if (y % surface->tileSize == 0 && firstTileRow > 0) firstTileRow--;
+    unsigned int lastTileRow = (y + height - 1) / surface->tileSize;
+    if (lastTileRow >= surface->tileCount) lastTileRow = surface->tileCount - 1;
+
+    UpdateTileRowBounds(surface, firstTileRow, lastTileRow - firstTileRow + 1);
+}
+
+void SurfacePushRow(Surface* surface, const float* heights)
+{
+    if (!surface->streaming) return;
+
+    uint32_t n = surface->n;
+    uint32_t row = surface->streamRow;
+
+    memcpy(surface->heights + (size_t)row * n, heights, sizeof(float) * n);
+
+    SurfaceMarkRowsChanged(surface, row, 1);
+
+    // The replaced row was the oldest and is now the newest
+    surface->streamRow = (row + 1) % n;
+}
+
+// Uploads each run of changed rows, limited to the changed columns
+static void UploadChangedRows(Surface* surface)
+{
+    surface->uploadedBytes = 0;
+    if (surface->dirtyColumnStart >= surface->dirtyColumnEnd) return;
+
+    VertexArray* va = &surface->vertexArray;
+    size_t rowSize = sizeof(float) * surface->n;
+    size_t columnOffset = sizeof(float) * surface->dirtyColumnStart;
+    size_t columnSize = sizeof(float) * (surface->dirtyColumnEnd - surface->dirtyColumnStart);
+
+    uint32_t row = 0;
+    while (row < surface->storageRows)
+    {
+        if (!surface->dirtyRows[row])
+        {
+            row++;
+            continue;
+        }
+
+        uint32_t runEnd = row + 1;
+        while (runEnd < surface->storageRows && surface->dirtyRows[runEnd]) runEnd++;
+
+        if (columnSize == rowSize)
+        {
+            VertexBufferUpdateRange(va, row * rowSize, (runEnd - row) * rowSize);
+        }
+        else
+        {
+            VertexBufferUpdateStrided(va, row * rowSize + columnOffset, columnSize, rowSize, runEnd - row);
+        }
+
+        surface->uploadedBytes += (runEnd - row) * columnSize;
+        row = runEnd;
+    }
+
+    memset(surface->dirtyRows, 0, surface->storageRows);
+    surface->dirtyColumnStart = surface->n;
+    surface->dirtyColumnEnd = 0;
+}
+
+// Packs a normal, scaled to a length of 511, as GL_INT_2_10_10_10_REV
+static uint32_t PackNormal(float x, float y, float z)
+{
+    return ((uint32_t)lrintf(x) & 0x3FF) | (((uint32_t)lrintf(y) & 0x3FF) << 10) |
+        (((uint32_t)lrintf(z) & 0x3FF) << 20);
+}
+
+// Returns the packed normal of a grid point from the negated slopes along x and y
+static uint32_t GridNormal(float slopeX, float slopeY)
+{
+    float length = 511.0f / sqrtf(slopeX * slopeX + slopeY * slopeY + 1.0f);
+    return PackNormal(slopeX * length, length, slopeY * length);
+}
+
+// Computes the normals of a range of ring rows that are out of date from central
+// differences of the heights, one sided at the edges of the grid
+static void ComputeRowNormals(unsigned int start, unsigned int end, void* context)
+{
+    Surface* surface = context;
+    uint32_t n = surface->n;
+    float slopeScaleX = 0.5f / surface->scale;
+
+    for (uint32_t row = start; row < end; row++)
+    {
+        if (!surface->dirtyNormalRows[row]) continue;
+
+        // Neighbouring rows in display order; streaming rows are shown from the stream row
+        uint32_t display = (row + n - surface->streamRow) % n;
+        uint32_t above = display > 0 ? (row + n - 1) % n : row;
+        uint32_t below = display + 1 < n ? (row + 1) % n : row;
+        float slopeScaleY = 1.0f / ((below != row) + (above != row)) / surface->scale;
+
+        const float* heights = surface->heights + (size_t)row * n;
+        const float* up = surface->heights + (size_t)above * n;
+        const float* down = surface->heights + (size_t)below * n;
+        uint32_t* normals = surface->normals + (size_t)row * n;
+
+        normals[0] = GridNormal((heights[0] - heights[1]) / surface->scale,
+            (up[0] - down[0]) * slopeScaleY);
+
+        uint32_t c = 1;
+
+#ifdef __SSE2__
+        __m128 vSlopeScaleX = _mm_set1_ps(slopeScaleX);
+        __m128 vSlopeScaleY = _mm_set1_ps(slopeScaleY);
+        __m128i mask = _mm_set1_epi32(0x3FF);
+
+        for (; c + 4 < n; c += 4)
+        {
+            __m128 slopeX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(heights + c - 1),
+                _mm_loadu_ps(heights + c + 1)), vSlopeScaleX);
+            __m128 slopeY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(up + c), _mm_loadu_ps(down + c)),
+                vSlopeScaleY);
+
+            // The approximate reciprocal square root is accurate to 12 bits, more than
+            // the 10 bits stored
+            __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX),
+                _mm_mul_ps(slopeY, slopeY)), _mm_set1_ps(1.0f));
+            __m128 length = _mm_mul_ps(_mm_rsqrt_ps(lengthSquared), _mm_set1_ps(511.0f));
+
+            __m128i x = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(slopeX, length)), mask);
+            __m128i y = _mm_and_si128(_mm_cvtps_epi32(length), mask);
+            __m128i z = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(slopeY, length)), mask);
+            __m128i packed = _mm_or_si128(x, _mm_or_si128(_mm_slli_epi32(y, 10), _mm_slli_epi32(z, 20)));
+            _mm_storeu_si128((__m128i*)(normals + c), packed);
+        }
+#endif
+
+        for (; c + 1 < n; c++)
+        {
+            normals[c] = GridNormal((heights[c - 1] - heights[c + 1]) * slopeScaleX,
+                (up[c] - down[c]) * slopeScaleY);
+        }
+
+        normals[n - 1] = GridNormal((heights[n - 2] - heights[n - 1]) / surface->scale,
+            (up[n - 1] - down[n - 1]) * slopeScaleY);
+
+        // Streaming surfaces repeat the first tile row after the last
+        if (row < surface->storageRows - n)
+        {
+            memcpy(surface->normals + (size_t)(n + row) * n, normals, sizeof(uint32_t) * n);
+        }
+    }
+}
+
+// Recomputes the out of date normals across threads and uploads each run of their rows
+static void UpdateNormals(Surface* surface)
+{
+    uint32_t n = surface->n;
+    bool changed = false;
+    for (uint32_t row = 0; row < n; row++)
+    {
+        if (!surface->dirtyNormalRows[row]) continue;
+
+        changed = true;
+        if (row < surface->storageRows - n) surface->dirtyNormalRows[n + row] = 1;
+    }
+
+    if (!changed) return;
+
+    unsigned int minRows = SurfacePointsPerThread / n + 1;
+    ParallelFor(n, minRows, ComputeRowNormals, surface);
+
+    RendererBindBuffer(GL_ARRAY_BUFFER, surface->normalBufferId);
+
+    size_t rowSize = sizeof(uint32_t) * n;
+    uint32_t row = 0;
+    while (row < surface->storageRows)
+    {
+        if (!surface->dirtyNormalRows[row])
+        {
+            row++;
+            continue;
+        }
+
+        uint32_t runEnd = row + 1;
+        while (runEnd < surface->storageRows && surface->dirtyNormalRows[runEnd]) runEnd++;
+
+        GLCall(glBufferSubData(GL_ARRAY_BUFFER, row * rowSize, (runEnd - row) * rowSize,
+            surface->normals + (size_t)row * n));
+
+        surface->uploadedBytes += (runEnd - row) * rowSize;
+        row = runEnd;
+    }
+
+    memset(surface->dirtyNormalRows, 0, surface->storageRows);
+}
+
+static void EvaluateExpression(const float* x, float y, float time, unsigned int count,
+    float* heights, void* userData)
+{
+    const SurfaceExpression* e = userData;
+    float a = e->amplitude;
+    float k = e->frequency;
+    float phase = e->speed * time;
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    __m128 va = _mm_set1_ps(a);
+    __m128 vk = _mm_set1_ps(k);
+    __m128 vy = _mm_set1_ps(y);
+    __m128 vPhase = _mm_set1_ps(phase);
+
+    // Terms that only depend on y are the same for the whole row
+    __m128 yTerm;
+    if (e->type == SurfaceExpressionGaussian)
+    {
+        yTerm = _mm_set1_ps(a * y * cosf(phase));
+    }
+    else
+    {
+        yTerm = _mm_mul_ps(va, Sin4(_mm_sub_ps(_mm_mul_ps(vk, vy), vPhase)));
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 h;
+
+        switch (e->type)
+        {
+            case SurfaceExpressionGaussian:
+            {
+                __m128 r2 = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+                __m128 falloff = Exp4(_mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), vk), r2));
+                h = _mm_mul_ps(_mm_mul_ps(yTerm, vx), falloff);
+                break;
+            }
+            case SurfaceExpressionRipple:
+            {
+                __m128 r = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+                h = _mm_mul_ps(va, Sin4(_mm_sub_ps(_mm_mul_ps(vk, r), vPhase)));
+                break;
+            }
+            default:
+            {
+                h = _mm_mul_ps(yTerm, Sin4(_mm_sub_ps(_mm_mul_ps(vk, vx), vPhase)));
+                break;
+            }
+        }
+
+        _mm_storeu_ps(heights + i, h);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        float r2 = x[i] * x[i] + y * y;
+        switch (e->type)
+        {
+            case SurfaceExpressionGaussian:
+                heights[i] = a * x[i] * y * expf(-k * r2) * cosf(phase);
+                break;
+            case SurfaceExpressionRipple:
+                heights[i] = a * sinf(k * sqrtf(r2) - phase);
+                break;
+            default:
+                heights[i] = a * sinf(k * x[i] - phase) * sinf(k * y - phase);
+                break;
+        }
+    }
+}
+
+void SurfaceGenerateExpression(Surface* surface, const SurfaceDomain* domain, float time,
+    const SurfaceExpression* expression)
+{
+    SurfaceGenerate(surface, domain, time, EvaluateExpression, (void*)expression);
+}
+
+static void TileBounds(const void* instances, unsigned int count,
+    float* x, float* y, float* z, float* radius)
+{
+    const SurfaceTile* tiles = instances;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        x[i] = tiles[i].center[0];
+        y[i] = tiles[i].center[1];
+        z[i] = tiles[i].center[2];
+        radius[i] = tiles[i].radius;
+    }
+}
+
+// Picks the level of detail of every tile from its distance to the camera, then
+// limits neighbouring tiles to differ by at most one level so that edges can be stitched
+// Narrow last tiles and the tiles next to them are kept at full detail, so that the
+// narrow tiles never border a coarser tile
+static void SelectTileLods(Surface* surface)
+{
+    vec3 cameraPosition;
+    CameraPosition(cameraPosition);
+
+    unsigned int tileCount = surface->tileCount;
+    unsigned char* lods = surface->tileLods;
+
+    for (unsigned int i = 0; i < tileCount * tileCount; i++)
+    {
+        const SurfaceTile* tile = &surface->tiles[i];
+        float distance = glm_vec3_distance(cameraPosition, (float*)tile->center) - tile->radius;
+
+        unsigned int x = i % tileCount, y = i / tileCount;
+        bool nearPartial = surface->lastTileSize < surface->tileSize &&
+            (x + 2 >= tileCount || y + 2 >= tileCount);
+
+        unsigned char lod = 0;
+        float lodDistance = surface->lodDistance;
+        while (!nearPartial && lod + 1 < surface->indexBuffer->lodCount && distance > lodDistance)
+        {
+            lod++;
+            lodDistance *= 2.0f;
+        }
+
+        lods[i] = lod;
+    }
+
+    // Two passes of a distance transform: lod <= neighbour lod + 1
+    for (unsigned int y = 0; y < tileCount; y++)
+    {
+        for (unsigned int x = 0; x < tileCount; x++)
+        {
+            unsigned char* lod = &lods[x + y * tileCount];
+            if (x > 0 && *lod > lod[-1] + 1) *lod = lod[-1] + 1;
+            if (y > 0 && *lod > lod[-(int)tileCount] + 1) *lod = lod[-(int)tileCount] + 1;
+        }
+    }
+
+    for (int y = tileCount - 1; y >= 0; y--)
+    {
+        for (int x = tileCount - 1; x >= 0; x--)
+        {
+            unsigned char* lod = &lods[x + y * tileCount];
+            if (x + 1 < tileCount && *lod > lod[1] + 1) *lod = lod[1] + 1;
+            if (y + 1 < tileCount && *lod > lod[tileCount] + 1) *lod = lod[tileCount] + 1;
+        }
+    }
+}
+
+// Returns the edges of a tile that border a coarser tile
+static unsigned int TileEdgeMask(Surface* surface, const SurfaceTile* tile)
+{
+    unsigned int tileCount = surface->tileCount;
+    const unsigned char* lods = surface->tileLods;
+    unsigned int i = tile->x + tile->y * tileCount;
+    unsigned int mask = 0;
+
+    if (tile->y > 0 && lods[i - tileCount] > lods[i]) mask |= 1;
+    if (tile->x + 1 < tileCount && lods[i + 1] > lods[i]) mask |= 2;
+    if (tile->y + 1 < tileCount && lods[i + tileCount] > lods[i]) mask |= 4;
+    if (tile->x > 0 && lods[i - 1] > lods[i]) mask |= 8;
+
+    return mask;
+}
+
+// Draws the tiles in the view frustum with one indirect draw
+void SurfaceDraw(Surface* surface)
+{
+    VertexArray* va = &surface->vertexArray;
+    TimerBeginZone("Surface");
+
+    TimerBeginZone("Surface upload");
+    UploadChangedRows(surface);
+    if (surface->lit && surface->heights) UpdateNormals(surface);
+    TimerEndZone();
+
+    TimerBeginZone("Surface cull");
+    if (surface->boundsDirty) UpdateStreamingTileBounds(surface);
+    SelectTileLods(surface);
+
+    unsigned int visibleCount = CullInstances(&frustum, TileBounds, surface->tiles,
+        surface->tileCount * surface->tileCount, sizeof(SurfaceTile), surface->visibleTiles);
+    surface->visibleTileCount = visibleCount;
+    TimerEndZone();
+
+    if (visibleCount == 0)
+    {
+        TimerEndZone();
+        return;
+    }
+
+    for (unsigned int i = 0; i < visibleCount; i++)
+    {
+        const SurfaceTile* tile = &surface->visibleTiles[i];
+        unsigned int lod = surface->tileLods[tile->x + tile->y * surface->tileCount];
+        const SurfaceIndexSet* set =
+            &surface->indexBuffer->indexSets[lod * SurfaceEdgeMaskCount + TileEdgeMask(surface, tile)];
+
+        // Narrow tiles: 1 in the last column, 2 in the last row, 3 in the corner
+        unsigned int partial = (TileExtent(surface, tile->x) < surface->tileSize) +
+            2 * (TileExtent(surface, tile->y) < surface->tileSize);
+        if (partial) set = &surface->indexBuffer->partialSets[partial - 1];
+
+        DrawElementsIndirectCommand* command = &surface->drawCommands[i];
+        command->count = set->count;
+        command->instanceCount = 1;
+        command->firstIndex = set->first;
+        uint32_t firstRow = (tile->y * surface->tileSize + surface->streamRow) % surface->n;
+        command->baseVertex = tile->x * surface->tileSize + firstRow * surface->n;
+        command->baseInstance = 0;
+    }
+
+    IndirectBufferUpdateRange(&surface->drawCommandsBuffer, 0,
+        visibleCount * sizeof(DrawElementsIndirectCommand));
+
+    TimerBeginZone("Surface draw");
+    unsigned int shaderId = surface->shaderId;
+    ShaderUse(shaderId);
+
+    ShaderSetVec3(shaderId, "origin", surface->origin);
+    ShaderSetFloat(shaderId, "scale", surface->scale);
+    ShaderSetInt(shaderId, "n", surface->n);
+    ShaderSetInt(shaderId, "rowOffset", surface->streamRow);
+    ShaderSetInt(shaderId, "colorMode", surface->colorMode);
+    ShaderSetInt(shaderId, "lit", surface->lit);
+
+    if (!surface->heights)
+    {
+        ShaderSetVec2(shaderId, "domainMin", surface->domain.min);
+        ShaderSetFloat(shaderId, "domainStep", surface->domain.step);
+        ShaderSetFloat(shaderId, "time", surface->time);
+    }
+
+    if (surface->lit)
+    {
+        ShaderSetVec3(shaderId, "lightDirection", lightDirection);
+    }
+
+    if (surface->colorMode == SurfaceColorMap)
+    {
+        ShaderSetVec2(shaderId, "colormapRange", surface->colormapRange);
+        GLCall(glActiveTexture(GL_TEXTURE0));
+        GLCall(glBindTexture(GL_TEXTURE_1D, surface->colormapTextureId));
+    }
+
+    VertexArrayBind(va);
+    IndirectBufferBind(&surface->drawCommandsBuffer);
+    GLenum primitive = surface->indexBuffer->mode == SurfacePrimitiveStrips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+    GLCall(glMultiDrawElementsIndirect(primitive, GL_UNSIGNED_INT, 0, visibleCount, 0));
+    TimerEndZone();
+
+    TimerEndZone();
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <stdbool.h>
+#include <cglm\cglm.h>
+#include "renderer.h"
+
+// Tiles are at most this many grid squares wide
+// When no tile size from SurfaceMinTileSize up divides n - 1, the last tile row and
+// column are narrower and always drawn at full detail
+#define SurfaceMaxTileSize 64
+#define SurfaceMinTileSize 4
+
+// Grids are at most this many vertices across so that vertex indices fit in an int
+#define SurfaceMaxSize 32768
+
+// Each level of detail halves the grid resolution inside a tile
+#define SurfaceMaxLodCount 6
+
+// Bit i is set when edge i (top, right, bottom, left) of a tile
+// borders a tile drawn at the next coarser level of detail
+#define SurfaceEdgeMaskCount 16
+
+// Narrow tiles in the last column, the last row and the corner between them
+#define SurfacePartialSetCount 3
+
+// A square block of the surface grid, culled and given a level of detail as a unit
+typedef struct SurfaceTile
+{
+    vec3 center; // Bounding sphere in world space
+    float radius;
+    float minHeight;
+    float maxHeight;
+    unsigned int x; // Position in the grid of tiles
+    unsigned int y;
+} SurfaceTile;
+
+// A range of the index buffer holding the triangles of one tile
+typedef struct SurfaceIndexSet
+{
+    unsigned int first;
+    unsigned int count;
+} SurfaceIndexSet;
+
+typedef enum SurfacePrimitiveMode
+{
+    SurfacePrimitiveTriangles, // Triangle lists
+    SurfacePrimitiveStrips, // Triangle strips split by primitive restart; about a third fewer indices
+} SurfacePrimitiveMode;
+
+// The index sets of every level of detail and edge mask for one grid size,
+// shared by all surfaces of that size and primitive mode
+// Index sets are indexed by lod * SurfaceEdgeMaskCount + edge mask
+typedef struct SurfaceIndexBuffer
+{
+    uint32_t n;
+    SurfacePrimitiveMode mode;
+    unsigned int refCount;
+    unsigned int bufferId;
+    unsigned int count;
+    uint32_t lodCount;
+    SurfaceIndexSet indexSets[SurfaceMaxLodCount * SurfaceEdgeMaskCount];
+    SurfaceIndexSet partialSets[SurfacePartialSetCount]; // Full detail only; empty if tiles fit exactly
+    struct SurfaceIndexBuffer* next;
+} SurfaceIndexBuffer;
+
+typedef enum SurfaceColorMode
+{
+    SurfaceColorGrid, // Shaded by position in the grid
+    SurfaceColorVertex, // A static RGBA8 color for each grid point
+    SurfaceColorMap, // Heights looked up in a colormap texture
+} SurfaceColorMode;
+
+// The region of the (x, y) plane sampled by a surface's grid
+// Grid point (c, r) is sampled at (min[0] + c * step, min[1] + r * step)
+typedef struct SurfaceDomain
+{
+    vec2 min;
+    float step;
+} SurfaceDomain;
+
+// Represents some z = f(x, y)
+// The grid is n x n
+// TODO: refactor this to redefine the origin to the center of the surface
+// Instead of scale, allow the user to define a surface width dimension
+// TODO: allow for rectangular domains instead of just square
+typedef struct Surface
+{
+    vec3 origin; // The coordinates of the top left corner in world space
+    float scale; // The spacing between subsequent elements in the grid
+    float* heights; // (x, y) -> heights[x + y * n]; the only data uploaded when heights change; NULL if analytic
+    VertexArray vertexArray;
+    uint32_t n; // The number of elements along each dimension
+    uint32_t storageRows; // Rows of vertex data; streaming surfaces repeat the first tile row at the end
+    unsigned int shaderId;
+
+    // Analytic surfaces evaluate their function over the domain in the vertex shader
+    SurfaceDomain domain;
+    float time;
+
+    SurfaceColorMode colorMode;
+    unsigned int colorBufferId;
+    unsigned int colormapTextureId;
+    vec2 colormapRange; // The heights at the ends of the colormap
+
+    // Lit surfaces keep a normal for each grid point, recomputed only next to changed heights
+    bool lit;
+    uint32_t* normals; // Packed as GL_INT_2_10_10_10_REV and laid out like the heights
+    unsigned int normalBufferId;
+    unsigned char* dirtyNormalRows; // Rows whose normals are out of date or not uploaded
+
+    // Changed heights not yet uploaded: the flagged rows, between the dirty columns
+    unsigned char* dirtyRows;
+    uint32_t dirtyColumnStart;
+    uint32_t dirtyColumnEnd;
+    size_t uploadedBytes; // Vertex data uploaded by the last draw
+
+    // Streaming surfaces keep the last n rows pushed in a ring
+    bool streaming;
+    uint32_t streamRow; // The ring row shown first, which is the oldest
+    float* rowBounds; // (min, max) height of each ring row within each tile column
+    bool boundsDirty;
+
+    // The grid is drawn as tileCount x tileCount tiles of tileSize x tileSize squares,
+    // except that the last tile row and column may be narrower
+    uint32_t tileSize;
+    uint32_t tileCount;
+    uint32_t lastTileSize; // Squares across the last tile row and column; at most tileSize
+    float lodDistance; // Tiles closer than this are drawn at full detail; detail halves as distance doubles
+    SurfaceTile* tiles;
+    unsigned char* tileLods;
+    SurfaceTile* visibleTiles;
+    unsigned int visibleTileCount;
+    SurfaceIndexBuffer* indexBuffer;
+    DrawElementsIndirectCommand* drawCommands;
+    IndirectBuffer drawCommandsBuffer;
+} Surface;
+
+// Evaluates `count` heights of one grid row at the x coordinates in `x`
+// The loop over `x` should be simple enough for the compiler to vectorize
+typedef void (*SurfaceFunction)(const float* x, float y, float time, unsigned int count,
+    float* heights, void* userData);
+
+typedef enum SurfaceExpressionType
+{
+    SurfaceExpressionGaussian, // a * x * y * exp(-k * (x^2 + y^2)) * cos(w * t)
+    SurfaceExpressionRipple, // a * sin(k * sqrt(x^2 + y^2) - w * t)
+    SurfaceExpressionWaves, // a * sin(k * x - w * t) * sin(k * y - w * t)
+} SurfaceExpressionType;
+
+// A built-in height function evaluated with SIMD math
+typedef struct SurfaceExpression
+{
+    SurfaceExpressionType type;
+    float amplitude; // a
+    float frequency; // k
+    float speed; // w
+} SurfaceExpression;
+
+// The vertex shader of the surface program, which PolygonInitialize creates with its own
+extern const char* SurfaceVertShaderPath;
+
+// Initializes surface rendering with the program built from SurfaceVertShaderPath;
+// called by PolygonInitialize
+void SurfacesInitialize(UniformBuffer* vpMatrixBuffer, unsigned int shaderId);
+
+// Updates the frustum used to cull tiles
+void SurfacesUpdateViewPerspectiveMatrix(mat4 vpMatrix);
+
+// Sets the direction towards the light that shades lit surfaces
+void SurfacesSetLightDirection(vec3 direction);
+
+// Sets the primitives used by surfaces initialized after this call
+void SurfaceSetPrimitiveMode(SurfacePrimitiveMode mode);
+
+// n must be from 2 to SurfaceMaxSize
+void SurfaceInitialize(Surface* surface, vec3 origin, float scale, float* heights, uint32_t n);
+
+// Initializes a surface showing the last n rows given to SurfacePushRow, oldest first
+// The surface allocates its own heights; rows start flat
+// Heights are only set through SurfacePushRow
+void SurfaceInitializeStreaming(Surface* surface, vec3 origin, float scale, uint32_t n);
+
+// Initializes a surface whose heights are computed in the vertex shader, so none are
+// stored or uploaded. `function` is the GLSL body of float SurfaceHeight(float x, float y, float t),
+// for example "return 10.0 * x * y * exp(-(x * x + y * y)) * cos(t);"
+// Heights must stay between minHeight and maxHeight for tiles to be culled correctly
+// Returns false if the function does not compile
+bool SurfaceInitializeAnalytic(Surface* surface, vec3 origin, float scale, uint32_t n,
+    const SurfaceDomain* domain, const char* function, float minHeight, float maxHeight);
+
+// Frees the GPU resources of the surface; the heights belong to the caller
+// unless the surface is streaming
+void SurfaceDelete(Surface* surface);
+
+// Colors grid point (x, y) with the RGBA8 color at colors[4 * (x + y * n)]
+// The colors are uploaded once; streaming surfaces color ring rows rather than display rows
+void SurfaceSetColors(Surface* surface, const unsigned char* colors);
+
+// Colors the surface by height using `count` RGBA8 colors spread from minHeight to maxHeight
+void SurfaceSetColormap(Surface* surface, const unsigned char* colormap, unsigned int count,
+    float minHeight, float maxHeight);
+
+// Shades the surface with diffuse lighting from normals computed from the heights
+void SurfaceSetLighting(Surface* surface, bool lit);
+
+// Sets the t passed to the function of an analytic surface
+void SurfaceSetTime(Surface* surface, float time);
+
+// Fills the surface heights with z = f(x, y, time) over the domain
+// Analytic surfaces have no heights and are left unchanged by this and the functions below
+void SurfaceGenerate(Surface* surface, const SurfaceDomain* domain, float time,
+    SurfaceFunction function, void* userData);
+
+// Fills the surface heights with a built-in expression over the domain
+void SurfaceGenerateExpression(Surface* surface, const SurfaceDomain* domain, float time,
+    const SurfaceExpression* expression);
+
+// Marks rows of heights written directly as changed so that only they are uploaded
+void SurfaceMarkRowsChanged(Surface* surface, uint32_t firstRow, uint32_t rowCount);
+
+// Marks a rectangle of heights written directly as changed so that only it is uploaded
+void SurfaceMarkRegionChanged(Surface* surface, uint32_t x, uint32_t y, uint32_t width,
+    uint32_t height);
+
+// Replaces the oldest row of a streaming surface with n new heights
+// Only the new row is uploaded; other surfaces are left unchanged
+void SurfacePushRow(Surface* surface, const float* heights);
+
+void SurfaceDraw(Surface* surface);
\ No newline at end of file
@@ -1,6 +1,14 @@
 #define GLEW_STATIC
 #include <GL\glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include "timer.h"
+#include "debug.h"
 
 static int isTimerInitialized = 0;
 static unsigned int timerQuery = 0;
@@ -21,9 +29,466 @@ void TimerStop()
     glEndQuery(GL_TIME_ELAPSED);
 }
 
-unsigned int TimerGetNanosecondsElapsed()
+uint64_t TimerGetNanosecondsElapsed()
 {
-    unsigned int elapsedNs;
-    glGetQueryObjectuiv(timerQuery, GL_QUERY_RESULT, &elapsedNs);
+    GLuint64 elapsedNs;
+    glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsedNs);
     return elapsedNs;
+}
+
+// Frames in flight: a frame's queries are read back when its slot comes around again
+// If they are still not available the frame is dropped rather than waited on
+#define TimerFrameLatency 4
+#define TimerMaxZonesPerFrame 64
+#define TimerMaxDepth 16
+#define TimerMaxNames 64
+#define TimerHistoryLength 256
+
+// Marks a zone that did not fit in the frame, so that its end is still matched
+#define TimerNoZone 0xFFFFFFFFu
+
+typedef struct TimerZone
+{
+    unsigned int nameIndex;
+    uint64_t cpuStart;
+    uint64_t cpuEnd;
+} TimerZone;
+
+// The zones of one frame; zone i begins at query 2i and ends at query 2i + 1
+typedef struct TimerFrame
+{
+    unsigned int queries[TimerMaxZonesPerFrame * 2];
+    TimerZone zones[TimerMaxZonesPerFrame];
+    unsigned int zoneCount;
+    unsigned int lastQuery; // The query issued last, usually the end of the Frame zone
+    bool pending;
+} TimerFrame;
+
+// The last TimerHistoryLength frame totals of a named zone, in milliseconds
+typedef struct TimerHistory
+{
+    const char* name;
+    unsigned int depth; // Nesting depth where the zone was first seen, for the summary
+    float gpu[TimerHistoryLength];
+    float cpu[TimerHistoryLength];
+    unsigned int sampleCount;
+} TimerHistory;
+
+static TimerFrame frames[TimerFrameLatency];
+static unsigned int currentFrame;
+static bool isProfilerInitialized;
+static unsigned long droppedFrames;
+
+static unsigned int zoneStack[TimerMaxDepth];
+static unsigned int zoneDepth;
+static unsigned int skippedDepth; // Zones nested deeper than TimerMaxDepth
+
+static TimerHistory histories[TimerMaxNames];
+static unsigned int historyCount;
+
+// Trace events per thread; the oldest are overwritten once a buffer is full
+#define TimerTraceCapacity 65536
+
+typedef struct TimerTraceEvent
+{
+    const char* name; // NULL for the end of a zone
+    uint64_t timestamp;
+} TimerTraceEvent;
+
+// Each thread records into its own buffer, publishing events by advancing `count`
+// Buffers of exited threads keep their events and are reused by new threads
+typedef struct TimerTraceBuffer
+{
+    TimerTraceEvent events[TimerTraceCapacity];
+    atomic_ulong count;
+    atomic_bool recording; // Set while the owning thread writes an event
+    unsigned int threadId;
+    const char* threadName;
+    struct TimerTraceBuffer* nextBuffer; // Every buffer, for writing the trace
+    struct TimerTraceBuffer* nextFree;
+} TimerTraceBuffer;
+
+static _Thread_local TimerTraceBuffer* traceBuffer;
+static _Atomic(TimerTraceBuffer*) traceBuffers;
+static TimerTraceBuffer* freeTraceBuffers;
+static unsigned int traceBufferCount;
+static pthread_mutex_t traceBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t traceBufferKey;
+static pthread_once_t traceBufferKeyOnce = PTHREAD_ONCE_INIT;
+static atomic_ullong traceStart;
+
+// Set while the trace is written; events recorded meanwhile are dropped so that
+// full buffers are not overwritten as they are read
+static atomic_bool tracePaused;
+
+static uint64_t CpuNanoseconds()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + time.tv_nsec;
+}
+
+// Returns a thread's buffer to the free list when it exits
+static void ReleaseTraceBuffer(void* buffer)
+{
+    pthread_mutex_lock(&traceBufferMutex);
+    ((TimerTraceBuffer*)buffer)->nextFree = freeTraceBuffers;
+    freeTraceBuffers = buffer;
+    pthread_mutex_unlock(&traceBufferMutex);
+}
+
+static void CreateTraceBufferKey()
+{
+    pthread_key_create(&traceBufferKey, ReleaseTraceBuffer);
+}
+
+// Gives the calling thread a buffer the first time it records an event
+static TimerTraceBuffer* AcquireTraceBuffer()
+{
+    pthread_once(&traceBufferKeyOnce, CreateTraceBufferKey);
+
+    unsigned long long start = 0;
+    atomic_compare_exchange_strong(&traceStart, &start, CpuNanoseconds());
+
+    pthread_mutex_lock(&traceBufferMutex);
+    TimerTraceBuffer* buffer = freeTraceBuffers;
+    if (buffer)
+    {
+        freeTraceBuffers = buffer->nextFree;
+    }
+    else
+    {
+        buffer = calloc(1, sizeof(TimerTraceBuffer));
+        buffer->threadId = traceBufferCount++;
+        buffer->threadName = "Worker";
+        buffer->nextBuffer = atomic_load(&traceBuffers);
+        atomic_store(&traceBuffers, buffer);
+    }
+    pthread_mutex_unlock(&traceBufferMutex);
+
+    pthread_setspecific(traceBufferKey, buffer);
+    traceBuffer = buffer;
+    return buffer;
+}
+
+// Only the owning thread writes to a buffer, so recording takes no lock
+// The writer of the trace pauses recording and then waits for `recording` to clear,
+// while a thread sets `recording` before checking for a pause
+static void RecordTraceEvent(const char* name)
+{
+    TimerTraceBuffer* buffer = traceBuffer ? traceBuffer : AcquireTraceBuffer();
+    atomic_store(&buffer->recording, true);
+    if (!atomic_load(&tracePaused))
+    {
+        unsigned long index = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+        TimerTraceEvent* event = &buffer->events[index % TimerTraceCapacity];
+        event->name = name;
+        event->timestamp = CpuNanoseconds();
+        atomic_store_explicit(&buffer->count, index + 1, memory_order_release);
+    }
+    atomic_store_explicit(&buffer->recording, false, memory_order_release);
+}
+
+void TimerTraceNameThread(const char* name)
+{
+    TimerTraceBuffer* buffer = traceBuffer ? traceBuffer : AcquireTraceBuffer();
+    buffer->threadName = name;
+}
+
+void TimerTraceBegin(const char* name)
+{
+    RecordTraceEvent(name);
+}
+
+void TimerTraceEnd()
+{
+    RecordTraceEvent(NULL);
+}
+
+static void WriteTraceString(FILE* file, const char* string)
+{
+    fputc('"', file);
+    for (; *string; string++)
+    {
+        if (*string == '"' || *string == '\\') fputc('\\', file);
+        fputc(*string, file);
+    }
+    fputc('"', file);
+}
+
+bool TimerWriteTrace(const char* filePath)
+{
+    FILE* file = fopen(filePath, "w");
+    if (file == NULL)
+    {
+        printf("Error opening file at path: %s\n", filePath);
+        return false;
+    }
+
+    // Wait for events being recorded; none are recorded until the trace is written
+    atomic_store(&tracePaused, true);
+    for (TimerTraceBuffer* buffer = atomic_load(&traceBuffers); buffer; buffer = buffer->nextBuffer)
+    {
+        while (atomic_load(&buffer->recording)) sched_yield();
+    }
+
+    uint64_t start = atomic_load(&traceStart);
+    unsigned long eventCount = 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+
+    for (TimerTraceBuffer* buffer = atomic_load(&traceBuffers); buffer; buffer = buffer->nextBuffer)
+    {
+        fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+            first ? "" : ",", buffer->threadId);
+        WriteTraceString(file, buffer->threadName);
+        fprintf(file, "}}");
+        first = false;
+
+        unsigned long count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+        unsigned long oldest = count > TimerTraceCapacity ? count - TimerTraceCapacity : 0;
+
+        for (unsigned long i = oldest; i < count; i++)
+        {
+            const TimerTraceEvent* event = &buffer->events[i % TimerTraceCapacity];
+            double timestamp = (event->timestamp - start) * 1e-3;
+
+            if (event->name)
+            {
+                fprintf(file, ",\n{\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":",
+                    buffer->threadId, timestamp);
+                WriteTraceString(file, event->name);
+                fputc('}', file);
+            }
+            else
+            {
+                fprintf(file, ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                    buffer->threadId, timestamp);
+            }
+        }
+
+        eventCount += count - oldest;
+    }
+
+    atomic_store(&tracePaused, false);
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Wrote %lu trace events to '%s'\n", eventCount, filePath);
+    return true;
+}
+
+// Returns the index of the zone's history, adding it if it is new, or TimerNoZone if full
+static unsigned int FindHistory(const char* name, unsigned int depth)
+{
+    for (unsigned int i = 0; i < historyCount; i++)
+    {
+        if (histories[i].name == name || strcmp(histories[i].name, name) == 0) return i;
+    }
+
+    if (historyCount == TimerMaxNames) return TimerNoZone;
+
+    histories[historyCount].name = name;
+    histories[historyCount].depth = depth;
+    return historyCount++;
+}
+
+// Adds the zones of a frame to their histories if its queries have completed
+static void ReadFrame(TimerFrame* frame)
+{
+    if (frame->zoneCount == 0) return;
+
+    // Queries complete in order, so the last one issued being available means all of them are
+    GLint available = 0;
+    GLCall(glGetQueryObjectiv(frame->queries[frame->lastQuery], GL_QUERY_RESULT_AVAILABLE,
+        &available));
+    if (!available)
+    {
+        droppedFrames++;
+        return;
+    }
+
+    double gpuTotals[TimerMaxNames] = { 0 };
+    double cpuTotals[TimerMaxNames] = { 0 };
+    bool seen[TimerMaxNames] = { false };
+
+    for (unsigned int i = 0; i < frame->zoneCount; i++)
+    {
+        const TimerZone* zone = &frame->zones[i];
+        GLuint64 start, end;
+        GLCall(glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT, &start));
+        GLCall(glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &end));
+
+        gpuTotals[zone->nameIndex] += (end - start) * 1e-6;
+        cpuTotals[zone->nameIndex] += (zone->cpuEnd - zone->cpuStart) * 1e-6;
+        seen[zone->nameIndex] = true;
+    }
+
+    for (unsigned int i = 0; i < historyCount; i++)
+    {
+        if (!seen[i]) continue;
+
+        TimerHistory* history = &histories[i];
+        unsigned int slot = history->sampleCount % TimerHistoryLength;
+        history->gpu[slot] = gpuTotals[i];
+        history->cpu[slot] = cpuTotals[i];
+        history->sampleCount++;
+    }
+}
+
+void TimerBeginFrame()
+{
+    if (!isProfilerInitialized)
+    {
+        for (unsigned int i = 0; i < TimerFrameLatency; i++)
+        {
+            GLCall(glGenQueries(TimerMaxZonesPerFrame * 2, frames[i].queries));
+        }
+
+        isProfilerInitialized = true;
+
+        TimerTraceNameThread("Main");
+    }
+
+    currentFrame = (currentFrame + 1) % TimerFrameLatency;
+    TimerFrame* frame = &frames[currentFrame];
+    if (frame->pending) ReadFrame(frame);
+
+    frame->zoneCount = 0;
+    frame->pending = true;
+    zoneDepth = 0;
+
+    TimerBeginZone("Frame");
+}
+
+void TimerEndFrame()
+{
+    while (zoneDepth > 0)
+    {
+        TimerEndZone();
+    }
+}
+
+void TimerBeginZone(const char* name)
+{
+    TimerTraceBegin(name);
+    if (!isProfilerInitialized) return;
+
+    if (zoneDepth == TimerMaxDepth)
+    {
+        skippedDepth++;
+        return;
+    }
+
+    TimerFrame* frame = &frames[currentFrame];
+    unsigned int nameIndex = FindHistory(name, zoneDepth);
+    if (nameIndex == TimerNoZone || frame->zoneCount == TimerMaxZonesPerFrame)
+    {
+        zoneStack[zoneDepth++] = TimerNoZone;
+        return;
+    }
+
+    unsigned int zoneIndex = frame->zoneCount++;
+    zoneStack[zoneDepth++] = zoneIndex;
+
+    TimerZone* zone = &frame->zones[zoneIndex];
+    zone->nameIndex = nameIndex;
+    GLCall(glQueryCounter(frame->queries[zoneIndex * 2], GL_TIMESTAMP));
+    frame->lastQuery = zoneIndex * 2;
+    zone->cpuStart = CpuNanoseconds();
+}
+
+void TimerEndZone()
+{
+    TimerTraceEnd();
+
+    if (skippedDepth > 0)
+    {
+        skippedDepth--;
+        return;
+    }
+
+    if (zoneDepth == 0) return;
+
+    unsigned int zoneIndex = zoneStack[--zoneDepth];
+    if (zoneIndex == TimerNoZone) return;
+
+    TimerFrame* frame = &frames[currentFrame];
+    frame->zones[zoneIndex].cpuEnd = CpuNanoseconds();
+    GLCall(glQueryCounter(frame->queries[zoneIndex * 2 + 1], GL_TIMESTAMP));
+    frame->lastQuery = zoneIndex * 2 + 1;
+}
+
+static int CompareFloats(const void* a, const void* b)
+{
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static void ComputeStats(const float* samples, unsigned int sampleCount, TimerStats* stats)
+{
+    unsigned int count = sampleCount < TimerHistoryLength ? sampleCount : TimerHistoryLength;
+    stats->sampleCount = count;
+    if (count == 0)
+    {
+        stats->min = stats->avg = stats->p99 = 0.0f;
+        return;
+    }
+
+    float sorted[TimerHistoryLength];
+    memcpy(sorted, samples, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), CompareFloats);
+
+    double sum = 0.0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        sum += sorted[i];
+    }
+
+    stats->min = sorted[0];
+    stats->avg = sum / count;
+    stats->p99 = sorted[(count * 99 + 99) / 100 - 1];
+}
+
+bool TimerGetZoneStats(const char* name, TimerStats* gpu, TimerStats* cpu)
+{
+    for (unsigned int i = 0; i < historyCount; i++)
+    {
+        const TimerHistory* history = &histories[i];
+        if (history->sampleCount == 0 || strcmp(history->name, name) != 0) continue;
+
+        if (gpu) ComputeStats(history->gpu, history->sampleCount, gpu);
+        if (cpu) ComputeStats(history->cpu, history->sampleCount, cpu);
+        return true;
+    }
+
+    return false;
+}
+
+void TimerPrintSummary()
+{
+    printf("%-28s %26s %26s\n", "Zone (ms over recent frames)", "GPU min / avg / p99", "CPU min / avg / p99");
+
+    for (unsigned int i = 0; i < historyCount; i++)
+    {
+        const TimerHistory* history = &histories[i];
+        if (history->sampleCount == 0) continue;
+
+        TimerStats gpu, cpu;
+        ComputeStats(history->gpu, history->sampleCount, &gpu);
+        ComputeStats(history->cpu, history->sampleCount, &cpu);
+
+        char label[29];
+        snprintf(label, sizeof(label), "%*s%s", history->depth * 2, "", history->name);
+        printf("%-28s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", label,
+            gpu.min, gpu.avg, gpu.p99, cpu.min, cpu.avg, cpu.p99);
+    }
+
+    if (droppedFrames > 0)
+    {
+        printf("%lu frames were dropped from the profile while their queries were pending\n", droppedFrames);
+    }
 }
\ No newline at end of file
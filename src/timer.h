@@ -1,5 +1,46 @@
 #pragma once
+#include <stdint.h>
+#include <stdbool.h>
 
+// Times a single span of GPU work; reading the result waits for the GPU to finish it
 void TimerStart();
 void TimerStop();
-unsigned int TimerGetNanosecondsElapsed();
\ No newline at end of file
+uint64_t TimerGetNanosecondsElapsed();
+
+// Rolling statistics of a zone over recent frames, in milliseconds
+typedef struct TimerStats
+{
+    float min;
+    float avg;
+    float p99;
+    unsigned int sampleCount;
+} TimerStats;
+
+// Frame profiler: zones are timed on the GPU with timestamp queries and on the CPU with
+// a monotonic clock; GPU results are read a few frames later without waiting for them
+// Every frame is a zone named "Frame" that other zones nest in
+void TimerBeginFrame();
+void TimerEndFrame();
+
+// Zones nest and are identified by name; a name used several times in a frame is summed
+// The name is not copied and must outlive the profiler
+void TimerBeginZone(const char* name);
+void TimerEndZone();
+
+// Gets the statistics of a zone, returning false if it has not been recorded yet
+bool TimerGetZoneStats(const char* name, TimerStats* gpu, TimerStats* cpu);
+
+// Prints the statistics of every zone
+void TimerPrintSummary();
+
+// Records the CPU time of a zone for the trace only, from any thread
+// Zones timed with TimerBeginZone are also recorded
+void TimerTraceBegin(const char* name);
+void TimerTraceEnd();
+
+// Names the calling thread in the trace instead of "Worker"; the name is not copied
+void TimerTraceNameThread(const char* name);
+
+// Writes the recorded zones of every thread as Chrome Trace Event JSON, which can be
+// opened in chrome://tracing or Perfetto; returns false if the file cannot be written
+bool TimerWriteTrace(const char* filePath);
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <string.h>
+#include "triple_buffer.h"
+
+void TripleBufferInitialize(TripleBuffer* tripleBuffer, size_t size, const void* initial)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        tripleBuffer->buffers[i] = malloc(size);
+        memcpy(tripleBuffer->buffers[i], initial, size);
+    }
+
+    tripleBuffer->size = size;
+    tripleBuffer->writeIndex = 0;
+    tripleBuffer->readIndex = 1;
+    atomic_init(&tripleBuffer->shared, 2);
+}
+
+void* TripleBufferWriteBuffer(TripleBuffer* tripleBuffer)
+{
+    return tripleBuffer->buffers[tripleBuffer->writeIndex];
+}
+
+// Swaps the filled buffer with the shared one; release ordering makes its contents
+// visible to the reader that acquires it
+void TripleBufferPublish(TripleBuffer* tripleBuffer)
+{
+    unsigned int previous = atomic_exchange_explicit(&tripleBuffer->shared,
+        tripleBuffer->writeIndex | TripleBufferFresh, memory_order_acq_rel);
+    tripleBuffer->writeIndex = previous & ~TripleBufferFresh;
+}
+
+const void* TripleBufferRead(TripleBuffer* tripleBuffer)
+{
+    if (atomic_load_explicit(&tripleBuffer->shared, memory_order_relaxed) & TripleBufferFresh)
+    {
+        unsigned int previous = atomic_exchange_explicit(&tripleBuffer->shared,
+            tripleBuffer->readIndex, memory_order_acq_rel);
+        tripleBuffer->readIndex = previous & ~TripleBufferFresh;
+    }
+
+    return tripleBuffer->buffers[tripleBuffer->readIndex];
+}
+
+void TripleBufferDelete(TripleBuffer* tripleBuffer)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        free(tripleBuffer->buffers[i]);
+        tripleBuffer->buffers[i] = NULL;
+    }
+}
\ No newline at end of file
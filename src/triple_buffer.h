@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Set in TripleBuffer.shared when the buffer it names was published after the last read
+#define TripleBufferFresh 4u
+
+// Passes the latest of a stream of values from one writer thread to one reader thread
+// without locks: the writer fills one buffer while the reader holds another, and the
+// third holds the newest published value. Values the reader misses are overwritten
+typedef struct TripleBuffer
+{
+    void* buffers[3];
+    size_t size;
+    atomic_uint shared; // Index of the buffer neither thread holds, with TripleBufferFresh
+    unsigned int writeIndex; // Only used by the writer
+    unsigned int readIndex; // Only used by the reader
+} TripleBuffer;
+
+// Allocates three buffers of `size` bytes; each starts as a copy of `initial`, which the
+// reader sees until the first value is published
+void TripleBufferInitialize(TripleBuffer* tripleBuffer, size_t size, const void* initial);
+
+// Returns the buffer the writer fills before calling TripleBufferPublish
+void* TripleBufferWriteBuffer(TripleBuffer* tripleBuffer);
+void TripleBufferPublish(TripleBuffer* tripleBuffer);
+
+// Returns the newest published value, which stays valid until the next call
+const void* TripleBufferRead(TripleBuffer* tripleBuffer);
+
+void TripleBufferDelete(TripleBuffer* tripleBuffer);
\ No newline at end of file